@@ -0,0 +1,522 @@
+//
+//  AnimBench.cpp - headless benchmarks for the animation core
+//
+//  Builds synthetic skeletons and times the hot paths of the app without opening a
+//  window:
+//
+//    matrix/deep, matrix/wide    SceneObject::getMatrix() after the root moved
+//    pose/world                  SkeletonPose::computeWorld() (batch kernels + jobs)
+//    bake/linear, bake/ease      PoseCache::bake() of the whole playback range
+//    pick/joint                  Joint::intersect() (sphere, with hit point and normal)
+//    pick/ray                    Joint::intersectRay() (ray parameter only, as used by picking)
+//    pick/box                    SceneObject::intersectRay() of a box object (Cube, Cone, Mesh bounds)
+//    pick/bvh                    SceneBVH::intersect() over the whole skeleton
+//    pick/boxes                  nearestBox() of a ray against the world box of every joint (ops are boxes)
+//    pick/boxes/single           the same boxes one at a time with intersectRayBox() (ops are boxes)
+//    pick/boxes/<kernel>         the packet test alone, per kernel (scalar, sse, avx2)
+//    skin/linear                 skinLinear() over a tube skin of the skeleton (all threads)
+//    skin/linear/<kernel>        the same, one thread, per kernel (scalar, sse, avx2)
+//    skin/palette/dualquat       SkinPalette::build() with every bone moved (ops are bones)
+//    skin/dualquat               skinDualQuat() over the same skin (all threads)
+//    skin/dualquat/<kernel>      the same, one thread, per kernel
+//    cull/frustum                SceneCuller::update() + cull(), one rig moved, most rigs off screen
+//    select/marquee              marquee selection of joint positions (gather + boxesInFrustum())
+//    select/marquee/<kernel>     the packet test alone, per kernel (scalar, sse, avx2)
+//    io/text, io/binary          save + load round trip of the skeleton (both load SceneJoints)
+//    alloc/new, alloc/arena      create and drop a skeleton: new/delete vs. SceneArena
+//
+//  Results are written as JSON (stdout, or --out file):
+//
+//    { "benchmarks": [ { "name", "ops", "samples", "ns_per_op", "ops_per_sec",
+//                        "min_ns", "p50_ns", "p90_ns", "p99_ns" }, ... ] }
+//
+//  ns_per_op is the mean over all samples; the percentiles are of the per-sample
+//  ns/op.  Only needs the core library (../src/core), see ../CMakeLists.txt.
+//
+//  usage: AnimBench [--joints N] [--frames N] [--samples N] [--filter text] [--out file]
+//
+
+#include "SceneGraph.h"
+#include "SkeletonPose.h"
+#include "PoseCache.h"
+#include "SceneBVH.h"
+#include "BoxKernels.h"
+#include "SceneCuller.h"
+#include "SceneGenerator.h"
+#include "SkinnedMesh.h"
+#include "SkinKernels.h"
+#include "SceneIO.h"
+#include "SceneArena.h"
+#include <chrono>
+#include <cstdio>
+#include <cstring>
+#include <random>
+#include <string>
+#include <vector>
+#include <algorithm>
+#include <functional>
+
+struct BenchOptions {
+	int joints = 1000;
+	int frames = 500;
+	int samples = 30;
+	std::string filter;
+	std::string out;
+};
+
+struct BenchResult {
+	std::string name;
+	long long ops = 0;          // operations per sample
+	std::vector<double> nsPerOp;   // one entry per sample
+};
+
+// run body() (which performs ops operations) once to warm up, then samples times
+//
+static BenchResult runBench(const std::string &name, long long ops, int samples, const std::function<void()> &body) {
+	BenchResult result;
+	result.name = name;
+	result.ops = ops;
+	body();
+	for (int i = 0; i < samples; i++) {
+		auto start = std::chrono::steady_clock::now();
+		body();
+		auto stop = std::chrono::steady_clock::now();
+		double ns = std::chrono::duration<double, std::nano>(stop - start).count();
+		result.nsPerOp.push_back(ns / (double)ops);
+	}
+	return result;
+}
+
+static double percentile(std::vector<double> sorted, double p) {
+	if (sorted.empty()) return 0;
+	std::sort(sorted.begin(), sorted.end());
+	size_t i = (size_t)std::min(p * (sorted.size() - 1) + 0.5, (double)(sorted.size() - 1));
+	return sorted[i];
+}
+
+static void writeJson(FILE *f, const std::vector<BenchResult> &results) {
+	fprintf(f, "{\n  \"benchmarks\": [\n");
+	for (size_t i = 0; i < results.size(); i++) {
+		const BenchResult &r = results[i];
+		double mean = 0;
+		for (double ns : r.nsPerOp) mean += ns;
+		mean /= std::max((size_t)1, r.nsPerOp.size());
+		fprintf(f, "    { \"name\": \"%s\", \"ops\": %lld, \"samples\": %d, \"ns_per_op\": %.3f, \"ops_per_sec\": %.1f, "
+			"\"min_ns\": %.3f, \"p50_ns\": %.3f, \"p90_ns\": %.3f, \"p99_ns\": %.3f }%s\n",
+			r.name.c_str(), r.ops, (int)r.nsPerOp.size(), mean, (mean > 0 ? 1e9 / mean : 0),
+			percentile(r.nsPerOp, 0), percentile(r.nsPerOp, 0.5), percentile(r.nsPerOp, 0.9), percentile(r.nsPerOp, 0.99),
+			(i + 1 < results.size() ? "," : ""));
+	}
+	fprintf(f, "  ]\n}\n");
+}
+
+//--------------------------------------------------------------
+// synthetic scenes
+//
+
+// a single chain of count joints
+//
+static void makeChain(std::vector<SceneObject *> &scene, int count) {
+	Joint *parent = NULL;
+	for (int i = 0; i < count; i++) {
+		Joint *joint = new Joint("chain" + std::to_string(i), 0.5f);
+		joint->position = glm::vec3(0, 1, 0);
+		joint->rotation = glm::vec3(0, 0, 2);
+		if (parent) parent->addChild(joint);
+		scene.push_back(joint);
+		parent = joint;
+	}
+}
+
+// one root with count - 1 children
+//
+static void makeFan(std::vector<SceneObject *> &scene, int count) {
+	Joint *root = new Joint("root", 0.5f);
+	scene.push_back(root);
+	for (int i = 1; i < count; i++) {
+		Joint *joint = new Joint("fan" + std::to_string(i), 0.5f);
+		joint->position = glm::vec3(cosf(i * 0.1f), 1, sinf(i * 0.1f)) * 3.0f;
+		root->addChild(joint);
+		scene.push_back(joint);
+	}
+}
+
+// a branching skeleton (rigs of up to 32 joints, each joint has up to
+// 3 children) with keys every 50 frames on every joint
+//
+static void makeSkeleton(std::vector<SceneObject *> &scene, int count, int frames, std::mt19937 &rng) {
+	std::uniform_real_distribution<float> u(-1, 1);
+	std::vector<Joint *> open;
+	for (int i = 0; i < count; i++) {
+		Joint *joint = new Joint("joint" + std::to_string(i), 0.5f);
+		joint->position = glm::vec3(u(rng), 1 + u(rng), u(rng));
+		if (i % 32 == 0) {
+			open.clear();
+			joint->position = glm::vec3(i / 32 * 4.0f, 0, 0);
+		}
+		else {
+			std::uniform_int_distribution<int> pick(0, (int)open.size() - 1);
+			int p = pick(rng);
+			open[p]->addChild(joint);
+			if (open[p]->childList.size() == 3) open.erase(open.begin() + p);
+		}
+		open.push_back(joint);
+		for (int f = 1; f <= frames; f += 50) {
+			KeyFrame key;
+			key.frame = f;
+			key.position = joint->position + glm::vec3(u(rng), u(rng), u(rng)) * 0.2f;
+			key.rotation = glm::vec3(u(rng), u(rng), u(rng)) * 45.0f;
+			key.orientation = SceneObject::eulerToQuat(key.rotation);
+			joint->setKey(key);
+		}
+		scene.push_back(joint);
+	}
+}
+
+// stands in for the app's Cube (Primitives.h): picked through the base
+// SceneObject::intersectRay(), i.e. the slab test of its local bounds
+//
+class PickBox : public SceneObject {
+public:
+	bool getLocalBounds(glm::vec3 &boundsMin, glm::vec3 &boundsMax) {
+		boundsMin = glm::vec3(-1, -1, -1);
+		boundsMax = glm::vec3(1, 1, 1);
+		return true;
+	}
+};
+
+static void deleteScene(std::vector<SceneObject *> &scene) {
+	for (auto obj : scene) delete obj;
+	scene.clear();
+}
+
+static void toSceneJoints(const SkeletonPose &pose, std::vector<SceneJoint> &joints) {
+	joints.resize(pose.size());
+	for (int i = 0; i < pose.size(); i++) {
+		Joint *joint = static_cast<Joint *>(pose.objects[i]);
+		SceneJoint &j = joints[i];
+		j.name = joint->name;
+		j.parent = pose.parent[i];
+		j.position = joint->position;
+		j.rotation = joint->rotation;
+		j.scale = joint->scale;
+		j.keyFrames = joint->keyFrames;
+	}
+}
+
+static std::vector<Ray> makeRays(int count, std::mt19937 &rng, float spread) {
+	std::uniform_real_distribution<float> u(-spread, spread);
+	std::vector<Ray> rays;
+	for (int i = 0; i < count; i++) {
+		glm::vec3 p(u(rng), u(rng), 50);
+		glm::vec3 target(u(rng) * 0.5f, u(rng) * 0.5f, 0);
+		rays.push_back(Ray(p, glm::normalize(target - p)));
+	}
+	return rays;
+}
+
+//--------------------------------------------------------------
+
+int main(int argc, char **argv) {
+	BenchOptions opt;
+	for (int i = 1; i < argc; i++) {
+		auto next = [&]() { return (i + 1 < argc ? argv[++i] : ""); };
+		if (!strcmp(argv[i], "--joints")) opt.joints = std::max(1, atoi(next()));
+		else if (!strcmp(argv[i], "--frames")) opt.frames = std::max(2, atoi(next()));
+		else if (!strcmp(argv[i], "--samples")) opt.samples = std::max(1, atoi(next()));
+		else if (!strcmp(argv[i], "--filter")) opt.filter = next();
+		else if (!strcmp(argv[i], "--out")) opt.out = next();
+		else {
+			fprintf(stderr, "usage: %s [--joints N] [--frames N] [--samples N] [--filter text] [--out file]\n", argv[0]);
+			return 1;
+		}
+	}
+
+	std::vector<BenchResult> results;
+	auto enabled = [&](const std::string &name) { return (opt.filter.empty() || name.find(opt.filter) != std::string::npos); };
+	auto bench = [&](const std::string &name, long long ops, const std::function<void()> &body) {
+		if (enabled(name)) results.push_back(runBench(name, ops, opt.samples, body));
+	};
+	std::mt19937 rng(1234);
+	volatile float sink = 0;     // keeps results alive
+
+	// getMatrix() with the whole hierarchy invalidated by moving the root
+	//
+	{
+		std::vector<SceneObject *> scene;
+		makeChain(scene, opt.joints);
+		bench("matrix/deep", opt.joints, [&] {
+			scene[0]->markDirty();
+			for (auto obj : scene) sink = sink + obj->getMatrix()[3][0];
+		});
+		deleteScene(scene);
+
+		makeFan(scene, opt.joints);
+		bench("matrix/wide", opt.joints, [&] {
+			scene[0]->markDirty();
+			for (auto obj : scene) sink = sink + obj->getMatrix()[3][0];
+		});
+		deleteScene(scene);
+	}
+
+	std::vector<SceneObject *> skeleton;
+	makeSkeleton(skeleton, opt.joints, opt.frames, rng);
+	SkeletonPose pose;
+	pose.build(skeleton);
+
+	bench("pose/world", pose.size(), [&] {
+		pose.computeWorld();
+	});
+
+	// baking the playback range is what interpolating the keys of every joint
+	// for every frame costs (world matrices included)
+	//
+	{
+		PoseCache cache;
+		cache.setup(pose, 1, opt.frames, true);
+		long long ops = (long long)pose.size() * opt.frames;
+		bench("bake/linear", ops, [&] {
+			cache.invalidate();
+			cache.bake(pose, false, false);
+		});
+		bench("bake/ease", ops, [&] {
+			cache.invalidate();
+			cache.bake(pose, true, false);
+		});
+	}
+
+	// picking
+	//
+	{
+		const int rayCount = 10000;
+		std::vector<Ray> rays = makeRays(rayCount, rng, 3);
+		Joint joint("pick", 1.0f);
+		joint.rotation = glm::vec3(10, 20, 30);
+		bench("pick/joint", rayCount, [&] {
+			glm::vec3 point, normal;
+			int hits = 0;
+			for (const Ray &ray : rays) hits += joint.intersect(ray, point, normal);
+			sink = sink + hits;
+		});
+		bench("pick/ray", rayCount, [&] {
+			float t;
+			int hits = 0;
+			for (const Ray &ray : rays) hits += joint.intersectRay(ray, t);
+			sink = sink + hits;
+		});
+		PickBox box;
+		box.rotation = glm::vec3(10, 20, 30);
+		bench("pick/box", rayCount, [&] {
+			float t;
+			int hits = 0;
+			for (const Ray &ray : rays) hits += box.intersectRay(ray, t);
+			sink = sink + hits;
+		});
+
+		SceneBVH bvh;
+		bvh.build(skeleton);
+		std::vector<Ray> sceneRays = makeRays(rayCount, rng, opt.joints / 32 * 4.0f + 4);
+		bench("pick/bvh", rayCount, [&] {
+			float t;
+			int hits = 0;
+			for (const Ray &ray : sceneRays) hits += (bvh.intersect(ray, t) != NULL);
+			sink = sink + hits;
+		});
+		// one ray against the world box of every joint, no tree; ops are box tests
+		//
+		BoxPackets boxes;
+		boxes.resize((int)skeleton.size());
+		for (int i = 0; i < boxes.size(); i++) {
+			glm::vec3 localMin, localMax, worldMin, worldMax;
+			skeleton[i]->getLocalBounds(localMin, localMax);
+			transformBounds(skeleton[i]->getMatrix(), localMin, localMax, worldMin, worldMax);
+			boxes.set(i, worldMin, worldMax);
+		}
+		const int boxRays = 100;
+		bench("pick/boxes", boxRays * boxes.size(), [&] {
+			RayBoxHit hit;
+			int hits = 0;
+			for (int r = 0; r < boxRays; r++) {
+				hits += nearestBox(boxes, 0, boxes.size(), sceneRays[r].p, sceneRays[r].d, 1e30f, hit);
+			}
+			sink = sink + hits;
+		});
+		bench("pick/boxes/single", boxRays * boxes.size(), [&] {
+			int hits = 0;
+			for (int r = 0; r < boxRays; r++) {
+				glm::vec3 invDir = rayInverse(sceneRays[r].d);
+				for (int i = 0; i < boxes.size(); i++) {
+					float tNear = 0, tFar = 1e30f;
+					hits += intersectRayBox(sceneRays[r].p, invDir, boxes.getMin(i), boxes.getMax(i), tNear, tFar);
+				}
+			}
+			sink = sink + hits;
+		});
+		for (const char *name : { "scalar", "sse", "avx2" }) {
+			const BoxKernel *kernel = boxKernelByName(name);
+			if (!kernel) continue;
+			bench(std::string("pick/boxes/") + name, boxRays * boxes.size(), [&] {
+				float tEntry[BOX_PACKET];
+				unsigned hits = 0;
+				for (int r = 0; r < boxRays; r++) {
+					glm::vec3 invDir = rayInverse(sceneRays[r].d);
+					for (int first = 0; first < boxes.size(); first += BOX_PACKET) {
+						hits += kernel->intersect(boxes, first, sceneRays[r].p, invDir, 0, 1e30f, tEntry);
+					}
+				}
+				sink = sink + hits;
+			});
+		}
+	}
+
+	// skinning; ops are vertices, so ops_per_sec is vertices per second
+	//
+	{
+		std::vector<SceneJoint> joints;
+		toSceneJoints(pose, joints);
+		SkinnedMesh skin;
+		generateSkin(joints, skin);
+		int count = skin.vertexCount();
+		std::vector<float> out(6 * (size_t)count);
+		pose.computeWorld();
+		const glm::mat4 *palette = pose.world.data();
+
+		bench("skin/linear", count, [&] {
+			skinLinear(skin, palette, out.data(), out.data() + 3 * count);
+			sink = sink + out[0];
+		});
+		for (const char *name : { "scalar", "sse", "avx2" }) {
+			const SkinKernel *kernel = skinKernelByName(name);
+			if (!kernel) continue;
+			bench(std::string("skin/linear/") + name, count, [&] {
+				kernel->linear(palette, skin.positions.data(), skin.normals.data(), skin.bones.data(), skin.weights.data(),
+					out.data(), out.data() + 3 * count, 0, count);
+				sink = sink + out[0];
+			});
+		}
+
+		// every bone gets a new version each round, so all of them are converted
+		//
+		int boneCount = (int)pose.world.size();
+		SkinPalette skinPalette;
+		skinPalette.reset(boneCount);
+		unsigned int version = 0;
+		bench("skin/palette/dualquat", boneCount, [&] {
+			version++;
+			for (int i = 0; i < boneCount; i++) skinPalette.set(i, pose.world[i], version);
+			sink = sink + skinPalette.build(SKIN_DUAL_QUAT);
+		});
+		const SkinDualQuat *dualQuats = skinPalette.dualQuats();
+
+		bench("skin/dualquat", count, [&] {
+			skinDualQuat(skin, dualQuats, out.data(), out.data() + 3 * count);
+			sink = sink + out[0];
+		});
+		for (const char *name : { "scalar", "sse", "avx2" }) {
+			const SkinKernel *kernel = skinKernelByName(name);
+			if (!kernel) continue;
+			bench(std::string("skin/dualquat/") + name, count, [&] {
+				kernel->dualQuat(dualQuats, skin.positions.data(), skin.normals.data(), skin.bones.data(), skin.weights.data(),
+					out.data(), out.data() + 3 * count, 0, count);
+				sink = sink + out[0];
+			});
+		}
+	}
+
+	// frustum culling; the camera sees the first few rigs of the row
+	//
+	{
+		SceneCuller culler;
+		culler.build(skeleton);
+		glm::mat4 view = glm::lookAt(glm::vec3(0, 0, 30), glm::vec3(0), glm::vec3(0, 1, 0));
+		glm::mat4 projection = glm::perspective(glm::radians(60.0f), 1.5f, 0.1f, 1000.0f);
+		Frustum frustum(projection * view);
+		bench("cull/frustum", culler.size(), [&] {
+			skeleton[0]->markDirty();
+			culler.update();
+			culler.cull(frustum);
+			sink = sink + culler.culledCount();
+		});
+
+		// marquee over the middle of a 1200 x 800 window: gather the joint
+		// positions and test them against the rectangle's frustum
+		//
+		Frustum marquee = Frustum::fromRect(projection * view, glm::vec4(0, 0, 1200, 800), glm::vec2(300, 200), glm::vec2(900, 600));
+		BoxPackets points;
+		std::vector<int> inside;
+		auto gather = [&] {
+			points.resize((int)skeleton.size());
+			for (int i = 0; i < (int)skeleton.size(); i++) {
+				glm::vec3 p = skeleton[i]->getMatrix()[3];
+				points.set(i, p, p);
+			}
+		};
+		gather();
+		bench("select/marquee", points.size(), [&] {
+			gather();
+			inside.clear();
+			sink = sink + boxesInFrustum(points, marquee.planes, inside);
+		});
+		for (const char *name : { "scalar", "sse", "avx2" }) {
+			const BoxKernel *kernel = boxKernelByName(name);
+			if (!kernel) continue;
+			bench(std::string("select/marquee/") + name, points.size(), [&] {
+				unsigned count = 0;
+				for (int first = 0; first < points.size(); first += BOX_PACKET) {
+					count += kernel->insideFrustum(points, first, marquee.planes);
+				}
+				sink = sink + count;
+			});
+		}
+	}
+
+	// save + load round trip
+	//
+	{
+		std::vector<SceneJoint> joints, loaded;
+		toSceneJoints(pose, joints);
+		long long keys = 0;
+		for (auto &j : joints) keys += j.keyFrames.size();
+
+		std::string textPath = "animbench.txt";
+		bench("io/text", keys, [&] {
+			writeTextScene(textPath, joints);
+			loaded.clear();
+			readTextScene(textPath, loaded);
+		});
+		remove(textPath.c_str());
+
+		std::string animPath = "animbench.hanim";
+		bench("io/binary", keys, [&] {
+			writeAnimFile(animPath, joints);
+			loaded.clear();
+			readAnimFile(animPath, loaded);
+		});
+		remove(animPath.c_str());
+	}
+	deleteScene(skeleton);
+
+	// creating and dropping a whole skeleton (loading a scene)
+	//
+	{
+		bench("alloc/new", opt.joints, [&] {
+			std::vector<SceneObject *> scene;
+			for (int i = 0; i < opt.joints; i++) scene.push_back(new Joint("joint", 0.5f));
+			deleteScene(scene);
+		});
+		SceneArena arena;
+		bench("alloc/arena", opt.joints, [&] {
+			for (int i = 0; i < opt.joints; i++) arena.create<Joint>("joint", 0.5f);
+			arena.clear();
+		});
+	}
+
+	FILE *f = (opt.out.empty() ? stdout : fopen(opt.out.c_str(), "w"));
+	if (!f) {
+		fprintf(stderr, "can't write %s\n", opt.out.c_str());
+		return 1;
+	}
+	writeJson(f, results);
+	if (f != stdout) fclose(f);
+	return 0;
+}
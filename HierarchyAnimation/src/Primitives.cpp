@@ -7,67 +7,61 @@
 
 #include "ofApp.h"
 #include "Primitives.h"
+#include <unordered_map>
 
-// Generate a rotation matrix that rotates v1 to v2
-// v1, v2 must be normalized
+//  intersection test with an object space axis aligned box.  The input ray is
+//  in world space and is moved to object space with the object's cached inverse
+//  (SceneObject::toObjectSpace()).  Like Sphere::intersect(), point and normal
+//  are returned in object space; the normal is the one of the face hit.
 //
-glm::mat4 SceneObject::rotateToVector(glm::vec3 v1, glm::vec3 v2) {
-
-	glm::vec3 axis = glm::cross(v1, v2);
-	glm::quat q = glm::angleAxis(glm::angle(v1, v2), glm::normalize(axis));
-	return glm::toMat4(q);
+static bool intersectLocalBox(SceneObject *obj, const Ray &ray, const glm::vec3 &boundsMin, const glm::vec3 &boundsMax,
+	glm::vec3 &point, glm::vec3 &normal) {
+
+	Ray local = obj->toObjectSpace(ray);
+	float tNear = 0, tFar = std::numeric_limits<float>::infinity();
+	if (!intersectRayBox(local.p, rayInverse(local.d), boundsMin, boundsMax, tNear, tFar)) return false;
+	point = local.p + local.d * tNear;
+	normal = boxFaceNormal(point, boundsMin, boundsMax);
+	return true;
 }
 
 
 // Draw a Unit cube (size = 2) transformed 
 //
 void Cone::draw() {
+	glm::mat4 m = getMatrix();
+	drawShape();
 
-	//rotateToVector(glm::vec3(0, 1, 0), glm::vec3(1, 1, 1));
+	// draw axis
+	//
+	ofApp::drawAxis(m, 1.5);
+}
 
-	glm::mat4 m = getMatrix();
+// the object itself, without axis
+//
+void Cone::drawShape() {
 
 	//   push the current stack matrix and multiply by this object's
 	//   matrix. now all vertices will be transformed by this matrix
 	//
 	ofPushMatrix();
-	ofMultMatrix(m);
+	ofMultMatrix(getMatrix());
 	ofDrawCone(radius, height);
 	ofPopMatrix();
+}
 
-
-	// draw axis
-	//
-	ofApp::drawAxis(m, 1.5);
-
+// cubes, cones and spheres are drawn directly; only their axis is instanced
+//
+void Cone::submit(SceneRenderer &renderer, bool bSelected) {
+	ofSetColor(bSelected ? ofColor::white : diffuseColor);
+	drawShape();
+	renderer.addAxis(getMatrix(), 1.5);
 }
 
-//  Cone::intersect - test intersection with bounding box.  Note that
-//  intersection test is done in object space with an axis aligned box (AAB), 
-//  the input ray is provided in world space, so we need to transform the ray to object space.
-//  this method does NOT return a normal.
+//  Cone::intersect - test intersection with bounding box (see intersectLocalBox())
 //
 bool Cone::intersect(const Ray &ray, glm::vec3 &point, glm::vec3 &normal) {
-
-	// transform Ray to object space.  
-	//
-	glm::mat4 mInv = glm::inverse(getMatrix());
-	glm::vec4 p = mInv * glm::vec4(ray.p.x, ray.p.y, ray.p.z, 1.0);
-	glm::vec4 p1 = mInv * glm::vec4(ray.p + ray.d, 1.0);
-	glm::vec3 d = glm::normalize(p1 - p);
-
-
-	// intesect method we use will be Willam's  (see box.h and box.cc for reference).
-	// note that this class has it's own version of Ray, Vector3  (TBD: port to GLM)
-	//
-	_Ray boxRay = _Ray(Vector3(p.x, p.y, p.z), Vector3(d.x, d.y, d.z));
-
-	// we will test for intersection in object space (object is a "unit" cube edge is len=2)
-	//
-	Box box = Box(Vector3(-radius, -radius, 0), Vector3(radius, radius, height));
-	return (box.intersect(boxRay, -1000, 1000));
-
-
+	return intersectLocalBox(this, ray, glm::vec3(-radius, -radius, 0), glm::vec3(radius, radius, height), point, normal);
 }
 
 
@@ -75,85 +69,83 @@ bool Cone::intersect(const Ray &ray, glm::vec3 &point, glm::vec3 &normal) {
 // Draw a Unit cube (size = 2) transformed 
 //
 void Cube::draw() {
+	glm::mat4 m = getMatrix();
+	drawShape();
 
-    //   get the current transformation matrix for this object
+	// draw axis
 	//
-	glm::mat4 m = getMatrix();
+	ofApp::drawAxis(m, 1.5);
+}
+
+// the object itself, without axis
+//
+void Cube::drawShape() {
 
 	//   push the current stack matrix and multiply by this object's
-	//   matrix. now all vertices dran will be transformed by this matrix
+	//   matrix. now all vertices will be transformed by this matrix
 	//
 	ofPushMatrix();
-	ofMultMatrix(m);
+	ofMultMatrix(getMatrix());
 	ofDrawBox(width, height, depth);
 	ofPopMatrix();
+}
+
+void Cube::submit(SceneRenderer &renderer, bool bSelected) {
+	ofSetColor(bSelected ? ofColor::white : diffuseColor);
+	drawShape();
+	renderer.addAxis(getMatrix(), 1.5);
+}
+
+void Sphere::draw() {
+	glm::mat4 m = getMatrix();
+	drawShape();
 
 	// draw axis
 	//
 	ofApp::drawAxis(m, 1.5);
-
 }
 
-void Sphere::draw() {
-
-	//   get the current transformation matrix for this object
-   //
-	glm::mat4 m = getMatrix();
+// the object itself, without axis
+//
+void Sphere::drawShape() {
 
 	//   push the current stack matrix and multiply by this object's
-	//   matrix. now all vertices dran will be transformed by this matrix
+	//   matrix. now all vertices will be transformed by this matrix
 	//
 	ofPushMatrix();
-	ofMultMatrix(m);
+	ofMultMatrix(getMatrix());
 	ofDrawSphere(radius);
 	ofPopMatrix();
+}
 
-	// draw axis
-	//
-	ofApp::drawAxis(m, 1.5);
-	
+void Sphere::submit(SceneRenderer &renderer, bool bSelected) {
+	ofSetColor(bSelected ? ofColor::white : diffuseColor);
+	drawShape();
+	renderer.addAxis(getMatrix(), 1.5);
 }
 
 bool Sphere::intersect(const Ray &ray, glm::vec3 &point, glm::vec3 &normal) {
 
 	// transform Ray to object space.  
 	//
-	glm::mat4 mInv = glm::inverse(getMatrix());
-	glm::vec4 p = mInv * glm::vec4(ray.p.x, ray.p.y, ray.p.z, 1.0);
-	glm::vec4 p1 = mInv * glm::vec4(ray.p + ray.d, 1.0);
-	glm::vec3 d = glm::normalize(p1 - p);
+	Ray local = toObjectSpace(ray);
+	return (glm::intersectRaySphere(local.p, glm::normalize(local.d), glm::vec3(0, 0, 0), radius, point, normal));
+}
 
-	return (glm::intersectRaySphere(glm::vec3(p), d, glm::vec3(0, 0, 0), radius, point, normal));
+// same as SceneObject::intersectRay(), but against the sphere itself
+//
+bool Sphere::intersectRay(const Ray &ray, float &t) {
+	Ray local = toObjectSpace(ray);
+	return intersectRaySphere(local.p, local.d, radius, t);
 }
 
 
 
 
-//  Cube::intersect - test intersection with the unit Cube.  Note that
-//  intersection test is done in object space with an axis aligned box (AAB), 
-//  the input ray is provided in world space, so we need to transform the ray to object space.
-//  this method does NOT return a normal.
+//  Cube::intersect - test intersection with the Cube (see intersectLocalBox())
 //
 bool Cube::intersect(const Ray &ray, glm::vec3 &point, glm::vec3 &normal) {
-
-	// transform Ray to object space.  
-	//
-	glm::mat4 mInv = glm::inverse(getMatrix());
-	glm::vec4 p = mInv * glm::vec4(ray.p.x, ray.p.y, ray.p.z, 1.0);
-	glm::vec4 p1 = mInv * glm::vec4(ray.p + ray.d, 1.0);
-	glm::vec3 d = glm::normalize(p1 - p);
-
-
-	// intesect method we use will be Willam's  (see box.h and box.cc for reference).
-	// note that this class has it's own version of Ray, Vector3  (TBD: port to GLM)
-	//
-	_Ray boxRay = _Ray(Vector3(p.x, p.y, p.z), Vector3(d.x, d.y, d.z));
-
-	// we will test for intersection in object space (object is a "unit" cube edge is len=2)
-	//
-	Box box = Box(Vector3(-width/2.0, -height/2.0, -depth/2.0), Vector3(width/2.0, height/2.0, depth/2.0));
-	return (box.intersect(boxRay, -1000, 1000));
-
+	return intersectLocalBox(this, ray, glm::vec3(-width / 2, -height / 2, -depth / 2), glm::vec3(width / 2, height / 2, depth / 2), point, normal);
 }
 
 
@@ -176,7 +168,7 @@ bool Plane::intersect(const Ray &ray, glm::vec3 & point, glm::vec3 & normalAtInt
 	return insidePlane;
 }
 
-void Joint::draw() {
+void JointShape::draw() {
 	// draw joint
 	ofPushMatrix();
 	ofMultMatrix(getMatrix());
@@ -201,3 +193,78 @@ void Joint::draw() {
 		ofPopMatrix();
 	}
 }
+
+void JointShape::submit(SceneRenderer &renderer, bool bSelected) {
+	renderer.addJoint(getMatrix(), radius, diffuseColor, bSelected);
+	if (parent) {
+		renderer.addBone(parent->getPosition(), getPosition(), 0.2f, diffuseColor, bSelected);
+	}
+}
+
+//--------------------------------------------------------------
+// skinned mesh
+//
+
+void Mesh::setSkin(const SkinnedMesh &skin) {
+	skinData = skin;
+	bones.assign(skinData.boneNames.size(), SceneHandle());
+	palette.reset((int)skinData.boneNames.size());
+	bBuffersReady = false;
+	bSkinned = false;
+}
+
+int Mesh::bind(const vector<Joint *> &sceneJoints) {
+	std::unordered_map<string, Joint *> joints;
+	for (Joint *joint : sceneJoints) joints.emplace(joint->name, joint);
+
+	int found = 0;
+	palette.reset((int)skinData.boneNames.size());
+	for (size_t i = 0; i < skinData.boneNames.size(); i++) {
+		auto joint = joints.find(skinData.boneNames[i]);
+		bones[i] = SceneHandle();
+		if (joint == joints.end()) continue;
+		bones[i] = joint->second->handle;
+		palette.bind((int)i, joint->second->getMatrix());
+		found++;
+	}
+	bSkinned = false;
+	return found;
+}
+
+void Mesh::setupBuffers() {
+	int count = skinData.vertexCount();
+	vertexBuffer.allocate(2 * 3 * sizeof(float) * count, GL_DYNAMIC_DRAW);
+	vbo.setVertexBuffer(vertexBuffer, 3, 3 * sizeof(float), 0);
+	vbo.setNormalBuffer(vertexBuffer, 3 * sizeof(float), 3 * sizeof(float) * count);
+	vbo.setIndexData(skinData.indices.data(), skinData.indices.size(), GL_STATIC_DRAW);
+	bBuffersReady = true;
+	bSkinned = false;
+}
+
+void Mesh::skin(const SceneArena &scene) {
+	int count = skinData.vertexCount();
+	if (count == 0) return;
+	for (size_t i = 0; i < bones.size(); i++) {
+		SceneObject *joint = scene.get(bones[i]);
+		if (!joint) continue;
+		glm::mat4 world = joint->getMatrix();    // brings worldVersion up to date
+		palette.set((int)i, world, joint->worldVersion);
+	}
+	if (!bBuffersReady) setupBuffers();
+	if (palette.build(skinMode) == 0 && bSkinned) return;
+
+	// the whole buffer is rewritten, so the old contents can be discarded
+	// (no wait for the GPU to finish the previous frame)
+	//
+	float *vertices = (float *)vertexBuffer.mapRange(0, 2 * 3 * sizeof(float) * count, GL_MAP_WRITE_BIT | GL_MAP_INVALIDATE_BUFFER_BIT);
+	if (!vertices) return;
+	if (skinMode == SKIN_DUAL_QUAT) skinDualQuat(skinData, palette.dualQuats(), vertices, vertices + 3 * count);
+	else skinLinear(skinData, palette.matrices(), vertices, vertices + 3 * count);
+	vertexBuffer.unmapRange();
+	bSkinned = true;
+}
+
+void Mesh::draw() {
+	if (!bBuffersReady) return;
+	vbo.drawElements(GL_TRIANGLES, skinData.indices.size());
+}
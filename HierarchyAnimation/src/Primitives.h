@@ -1,132 +1,43 @@
 //
 //  Primitives.h - Simple 3D Primitives with with Hierarchical Transformations
 //
+//  The transforms and the hierarchy live in SceneGraph.h; these classes add
+//  the openFrameworks drawing.
 //  
 //  (c) Kevin M. Smith  - 24 September 2018
 //
 #pragma once
 
 #include "ofMain.h"
-#include "box.h"
-#include "glm/gtx/euler_angles.hpp"
-#include "glm/gtx/intersect.hpp"
+#include "BoxKernels.h"
+#include "SceneGraph.h"
+#include "SceneArena.h"
+#include "SkinnedMesh.h"
 
-class KeyFrame;
+class SceneRenderer;
 
-//  General Purpose Ray class 
-//
-class Ray {
-public:
-	Ray(glm::vec3 p, glm::vec3 d) { this->p = p; this->d = d; }
-	void draw(float t) { ofDrawLine(p, p + t * d); }
-
-	glm::vec3 evalPoint(float t) {
-		return (p + t * d);
-	}
-
-	glm::vec3 p, d;
-};
 
 //  Base class for any renderable object in the scene
 //
-class SceneObject {
-public: 
+class Shape : public SceneObject {
+public:
 	virtual void draw() = 0;    // pure virtual funcs - must be overloaded
-	virtual bool intersect(const Ray &ray, glm::vec3 &point, glm::vec3 &normal) { return false; }
 
-	// commonly used transformations
+	// add this object to the instanced renderer.  objects without an
+	// instanced shape are drawn directly (selected objects in white).
 	//
-	glm::mat4 getRotateMatrix() {
-		return (glm::eulerAngleYXZ(glm::radians(rotation.y), glm::radians(rotation.x), glm::radians(rotation.z)));   // yaw, pitch, roll 
-	}
-	glm::mat4 getTranslateMatrix() {
-		return (glm::translate(glm::mat4(1.0), glm::vec3(position.x, position.y, position.z)));
+	virtual void submit(SceneRenderer &renderer, bool bSelected) {
+		ofSetColor(bSelected ? ofColor::white : diffuseColor);
+		draw();
 	}
-	glm::mat4 getScaleMatrix() {
-		return (glm::scale(glm::mat4(1.0), glm::vec3(scale.x, scale.y, scale.z)));
-	}
-
-
-	glm::mat4 getLocalMatrix() {
-
-		// get the local transformations + pivot
-		//
-		glm::mat4 scale = getScaleMatrix();
-		glm::mat4 rotate = getRotateMatrix();
-		glm::mat4 trans = getTranslateMatrix();
-
-		// handle pivot point  (rotate around a point that is not the object's center)
-		//
-		glm::mat4 pre = glm::translate(glm::mat4(1.0), glm::vec3(-pivot.x, -pivot.y, -pivot.z));
-		glm::mat4 post = glm::translate(glm::mat4(1.0), glm::vec3(pivot.x, pivot.y, pivot.z));
-
-	
-
-	    return (trans * post * rotate * pre * scale);
-
-	}
-
-	glm::mat4 getMatrix() {
-
-		// if we have a parent (we are not the root),
-		// concatenate parent's transform (this is recursive)
-		// 
-		if (parent) {
-			glm::mat4 M = parent->getMatrix();
-			return (M * getLocalMatrix());
-		}
-		else return getLocalMatrix();  // priority order is SRT
-	}
-
-	// get current Position in World Space
-	//
-	glm::vec3 getPosition() {
-		return (getMatrix() * glm::vec4(0.0, 0.0, 0.0, 1.0));
-	}
-
-	// set position (pos is in world space)
-	//
-	void setPosition(glm::vec3 pos) {
-		position = glm::inverse(getMatrix()) * glm::vec4(pos, 1.0);
-	}
-
-	// return a rotation  matrix that rotates one vector to another
-	//
-	glm::mat4 rotateToVector(glm::vec3 v1, glm::vec3 v2);
 
-	//  Hierarchy 
-	//
-	void addChild(SceneObject *child) {
-		childList.push_back(child);
-		child->parent = this;
-	}
-
-	SceneObject *parent = NULL;        // if parent = NULL, then this obj is the ROOT
-	vector<SceneObject *> childList;
-
-	// position/orientation 
-	//
-	glm::vec3 position = glm::vec3(0, 0, 0);   // translate
-	glm::vec3 rotation = glm::vec3(0, 0, 0);   // rotate
-	glm::vec3 scale = glm::vec3(1, 1, 1);      // scale
-
-	// rotate pivot
-	//
-	glm::vec3 pivot = glm::vec3(0, 0, 0);
-	 
 	// material properties (we will ultimately replace this with a Material class - TBD)
 	//
 	ofColor diffuseColor = ofColor::grey;    // default colors - can be changed.
 	ofColor specularColor = ofColor::lightGray;
-
-	// UI parameters
-	//
-	bool isSelectable = true;
-	bool isSelected = false;
-	string name = "SceneObject";
 };
 
-class Cone : public SceneObject {
+class Cone : public Shape {
 public:
 	Cone(ofColor color = ofColor::blue) {
 		diffuseColor = color;
@@ -138,13 +49,20 @@ public:
 		diffuseColor = color;
 	}
 	void draw();
+	void drawShape();
+	void submit(SceneRenderer &renderer, bool bSelected);
 	bool intersect(const Ray &ray, glm::vec3 &point, glm::vec3 &normal);
+	bool getLocalBounds(glm::vec3 &boundsMin, glm::vec3 &boundsMax) {
+		boundsMin = glm::vec3(-radius, -radius, 0);
+		boundsMax = glm::vec3(radius, radius, height);
+		return true;
+	}
 
 	float radius = 1.0;
 	float height = 2.0;
 };
 
-class Cube : public SceneObject {
+class Cube : public Shape {
 public:
 	Cube(ofColor color = ofColor::blue) {
 		diffuseColor = color;
@@ -156,7 +74,14 @@ public:
 		diffuseColor = color;
 	}
 	void draw();
+	void drawShape();
+	void submit(SceneRenderer &renderer, bool bSelected);
 	bool intersect(const Ray &ray, glm::vec3 &point, glm::vec3 &normal);
+	bool getLocalBounds(glm::vec3 &boundsMin, glm::vec3 &boundsMax) {
+		boundsMin = glm::vec3(-width / 2, -height / 2, -depth / 2);
+		boundsMax = glm::vec3(width / 2, height / 2, depth / 2);
+		return true;
+	}
 
 	float width = 2.0;
 	float height = 2.0;
@@ -165,28 +90,75 @@ public:
 
 //  General purpose sphere  (assume parametric)
 //
-class Sphere: public SceneObject {
+class Sphere: public Shape {
 public:
 	Sphere(glm::vec3 p, float r, ofColor diffuse = ofColor::lightGray) { position = p; radius = r; diffuseColor = diffuse; }
 	Sphere() {}
 	bool intersect(const Ray &ray, glm::vec3 &point, glm::vec3 &normal);
+	bool intersectRay(const Ray &ray, float &t);
+	bool getLocalBounds(glm::vec3 &boundsMin, glm::vec3 &boundsMax) {
+		boundsMin = glm::vec3(-radius);
+		boundsMax = glm::vec3(radius);
+		return true;
+	}
 	void draw();
+	void drawShape();
+	void submit(SceneRenderer &renderer, bool bSelected);
 
 	float radius = 1.0;
 };
 
 
-//  Mesh class (will complete later- this will be a refinement of Mesh from Project 1)
+//  Mesh skinned to joints of the scene (see SkinnedMesh.h).  skin() deforms the
+//  bind pose with the joints' current world matrices and writes the vertices
+//  straight into the mapped vertex buffer; draw() draws that buffer as it is.
+//  The vertices are in world space, so the mesh's own transform is not used.
+//  Each mesh picks its own skinning mode (linear blend or dual quaternion); if
+//  none of its joints moved since the last frame the buffer is left as it is.
 //
-class Mesh : public SceneObject {
+class Mesh : public Shape {
+public:
+	Mesh() {
+		name = "Mesh";
+		isSelectable = false;
+		diffuseColor = ofColor::lightSteelBlue;
+	}
+	void setSkin(const SkinnedMesh &skin);
+
+	// bind every bone to the joint of the same name, at the joint's current
+	// pose.  returns the number of bones found; the others stay in bind pose.
+	//
+	int bind(const vector<Joint *> &joints);
+
+	// bones whose joint has been deleted keep their last matrix
+	//
+	void skin(const SceneArena &scene);
+
+	void setSkinMode(SkinMode mode) { skinMode = mode; }
+	SkinMode getSkinMode() const { return skinMode; }
+
 	bool intersect(const Ray &ray, glm::vec3 &point, glm::vec3 &normal) { return false;  }
-	void draw() { }
+	void draw();
+
+	SkinnedMesh skinData;
+	vector<SceneHandle> bones;        // joint of each bone (null if not bound)
+	SkinPalette palette;
+
+private:
+	void setupBuffers();
+
+	SkinMode skinMode = SKIN_LINEAR;
+	bool bSkinned = false;            // buffer holds the vertices of the current palette
+
+	ofBufferObject vertexBuffer;      // positions, then normals (3 floats each)
+	ofVbo vbo;
+	bool bBuffersReady = false;
 };
 
 
 //  General purpose plane 
 //
-class Plane: public SceneObject {
+class Plane: public Shape {
 public:
 	Plane(glm::vec3 p, glm::vec3 n, ofColor diffuse = ofColor::darkGreen, float w = 20, float h = 20 ) {
 		position = p; normal = n;
@@ -208,8 +180,8 @@ public:
 	glm::vec3 normal = glm::vec3(0, 1, 0);
 	bool intersect(const Ray &ray, glm::vec3 & point, glm::vec3 & normal);
 	void draw() {
+		material.setDiffuseColor(diffuseColor);    // uploaded by begin()
 		material.begin();
-		material.setDiffuseColor(diffuseColor);
 		plane.drawFaces();
 		material.end();
 	}
@@ -220,12 +192,15 @@ public:
 	float height = 20;
 };
 
-class Joint: public Sphere {
+
+//  Joint drawn as a sphere, with a bone (cylinder) to its parent
+//
+class JointShape: public Joint {
 public:
-	Joint(const std::string& name, float r, ofColor diffuse = ofColor::lightGray) { this->name = name; radius = r; diffuseColor = diffuse; }
-	Joint() {}
+	JointShape(const std::string& name, float r, ofColor diffuse = ofColor::lightGray) : Joint(name, r) { diffuseColor = diffuse; }
+	JointShape() {}
 	void draw();
+	void submit(SceneRenderer &renderer, bool bSelected);
 
-	float radius = 1.0f;
-	vector<KeyFrame> keyFrames;
+	ofColor diffuseColor = ofColor::lightGray;
 };
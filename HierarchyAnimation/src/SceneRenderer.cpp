@@ -0,0 +1,160 @@
+//
+//  SceneRenderer.cpp - instanced drawing of joints, bones and axes
+//
+
+#include "SceneRenderer.h"
+
+static const char *vertexShader = R"(
+#version 150
+
+uniform mat4 modelViewMatrix;
+uniform mat4 modelViewProjectionMatrix;
+uniform samplerBuffer instances;
+uniform int useVertexColor;
+
+in vec4 position;
+in vec3 normal;
+in vec4 color;
+
+out vec3 eyePosition;
+out vec3 eyeNormal;
+out vec4 instanceColor;
+out float selected;
+
+void main() {
+	int base = gl_InstanceID * 5;
+	mat4 m = mat4(texelFetch(instances, base), texelFetch(instances, base + 1),
+		texelFetch(instances, base + 2), texelFetch(instances, base + 3));
+	vec4 c = texelFetch(instances, base + 4);
+
+	instanceColor = (useVertexColor != 0 ? color : vec4(c.rgb, 1.0));
+	selected = c.a;
+	eyePosition = vec3(modelViewMatrix * m * position);
+	eyeNormal = mat3(modelViewMatrix) * mat3(m) * normal;
+	gl_Position = modelViewProjectionMatrix * m * position;
+}
+)";
+
+static const char *fragmentShader = R"(
+#version 150
+
+uniform int useLighting;
+uniform vec3 lightPosition;     // eye space
+
+in vec3 eyePosition;
+in vec3 eyeNormal;
+in vec4 instanceColor;
+in float selected;
+
+out vec4 fragColor;
+
+void main() {
+	vec3 base = mix(instanceColor.rgb, vec3(1.0), selected);   // selected objects are drawn white
+	if (useLighting == 0) {
+		fragColor = vec4(base, 1.0);
+		return;
+	}
+	vec3 n = normalize(eyeNormal);
+	vec3 l = normalize(lightPosition - eyePosition);
+	float diffuse = abs(dot(n, l));
+	fragColor = vec4(base * (0.2 + 0.8 * diffuse), 1.0);
+}
+)";
+
+void SceneRenderer::setup() {
+	shader.setupShaderFromSource(GL_VERTEX_SHADER, vertexShader);
+	shader.setupShaderFromSource(GL_FRAGMENT_SHADER, fragmentShader);
+	shader.bindDefaults();
+	shader.linkProgram();
+
+	// unit meshes; the instance matrix scales them
+	//
+	joints.mesh = ofMesh::sphere(1.0, 16);
+	bones.mesh = ofMesh::cylinder(1.0, 1.0, 12, 1, 2, true);
+
+	axes.mesh.setMode(OF_PRIMITIVE_LINES);
+	glm::vec3 axis[3] = { glm::vec3(1, 0, 0), glm::vec3(0, 1, 0), glm::vec3(0, 0, 1) };
+	for (int i = 0; i < 3; i++) {
+		ofFloatColor c(axis[i].x, axis[i].y, axis[i].z);
+		axes.mesh.addVertex(glm::vec3(0, 0, 0));
+		axes.mesh.addColor(c);
+		axes.mesh.addVertex(axis[i]);
+		axes.mesh.addColor(c);
+	}
+}
+
+void SceneRenderer::begin() {
+	for (Batch *batch : { &joints, &bones, &axes }) {
+		batch->data.clear();
+		batch->count = 0;
+	}
+}
+
+void SceneRenderer::Batch::add(const glm::mat4 &m, const ofFloatColor &color, bool bSelected) {
+	data.push_back(m[0]);
+	data.push_back(m[1]);
+	data.push_back(m[2]);
+	data.push_back(m[3]);
+	data.push_back(glm::vec4(color.r, color.g, color.b, bSelected ? 1.0f : 0.0f));
+	count++;
+}
+
+void SceneRenderer::addJoint(const glm::mat4 &m, float radius, const ofFloatColor &color, bool bSelected) {
+	joints.add(m * glm::scale(glm::mat4(1.0), glm::vec3(radius)), color, bSelected);
+}
+
+// same placement as the old Joint::draw(): a cylinder centered between the two
+// points with its y axis rotated onto the bone
+//
+void SceneRenderer::addBone(const glm::vec3 &from, const glm::vec3 &to, float radius, const ofFloatColor &color, bool bSelected) {
+	glm::vec3 midPoint = (from + to) * 0.5f;
+	glm::vec3 direction = glm::normalize(to - from);
+	float length = glm::distance(from, to);
+
+	glm::vec3 up = glm::vec3(0, 1, 0);
+	glm::vec3 axis = glm::cross(up, direction);
+	glm::quat q = (glm::length(axis) > 1e-6f ? glm::angleAxis(glm::angle(up, direction), glm::normalize(axis)) :
+		(direction.y < 0 ? glm::angleAxis(glm::pi<float>(), glm::vec3(1, 0, 0)) : glm::quat(1, 0, 0, 0)));
+
+	glm::mat4 m = glm::translate(glm::mat4(1.0), midPoint) * glm::toMat4(q) *
+		glm::scale(glm::mat4(1.0), glm::vec3(radius, length, radius));
+	bones.add(m, color, bSelected);
+}
+
+void SceneRenderer::addAxis(const glm::mat4 &m, float len) {
+	axes.add(m * glm::scale(glm::mat4(1.0), glm::vec3(len)), ofFloatColor(1, 1, 1), false);
+}
+
+// upload the instance data (the buffer only grows) and draw all instances
+//
+void SceneRenderer::Batch::draw(const ofShader &shader) {
+	if (count == 0) return;
+
+	size_t bytes = data.size() * sizeof(glm::vec4);
+	if (bytes > capacity) {
+		capacity = std::max(bytes, capacity * 2);
+		buffer.allocate(capacity, GL_STREAM_DRAW);
+		texture.allocateAsBufferTexture(buffer, GL_RGBA32F);
+	}
+	buffer.updateData(0, bytes, data.data());
+
+	shader.setUniformTexture("instances", texture, 0);
+	mesh.drawInstanced(OF_MESH_FILL, count);
+}
+
+void SceneRenderer::draw(const glm::vec3 &lightPosition) {
+	glm::vec3 eyeLight = ofGetCurrentViewMatrix() * glm::vec4(lightPosition, 1.0);
+
+	shader.begin();
+	shader.setUniform3f("lightPosition", eyeLight);
+
+	shader.setUniform1i("useVertexColor", 0);
+	shader.setUniform1i("useLighting", 1);
+	joints.draw(shader);
+	bones.draw(shader);
+
+	shader.setUniform1i("useVertexColor", 1);
+	shader.setUniform1i("useLighting", 0);
+	axes.draw(shader);
+	shader.end();
+}
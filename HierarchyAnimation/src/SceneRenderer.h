@@ -0,0 +1,59 @@
+//
+//  SceneRenderer.h - instanced drawing of joints, bones and axes
+//
+//  Objects add themselves to per-type instance lists during ofApp::draw()
+//  (see SceneObject::submit()); each list is then drawn with one instanced
+//  call.  Per-instance data is a matrix and a color, stored as 5 RGBA32F texels
+//  in a buffer texture (the shader fetches them by gl_InstanceID):
+//
+//    texel 0..3   instance matrix columns
+//    texel 4      rgb = color, a = 1 if the object is selected (drawn highlighted)
+//
+//  Requires a GL 3.2 context (see main.cpp).
+//
+#pragma once
+
+#include "ofMain.h"
+
+class SceneRenderer {
+public:
+	void setup();
+
+	// start a new frame (clears all instance lists)
+	//
+	void begin();
+
+	// joint sphere of the given radius at world matrix m
+	//
+	void addJoint(const glm::mat4 &m, float radius, const ofFloatColor &color, bool bSelected);
+
+	// bone cylinder between two world positions
+	//
+	void addBone(const glm::vec3 &from, const glm::vec3 &to, float radius, const ofFloatColor &color, bool bSelected);
+
+	// x/y/z axis lines of length len at world matrix m (same as ofApp::drawAxis())
+	//
+	void addAxis(const glm::mat4 &m, float len);
+
+	// draw all lists; lightPosition is in world space
+	//
+	void draw(const glm::vec3 &lightPosition);
+
+	int instanceCount() const { return joints.count + bones.count + axes.count; }
+
+private:
+	struct Batch {
+		ofVboMesh mesh;
+		vector<glm::vec4> data;
+		ofBufferObject buffer;
+		ofTexture texture;
+		size_t capacity = 0;     // bytes allocated in buffer
+		int count = 0;
+
+		void add(const glm::mat4 &m, const ofFloatColor &color, bool bSelected);
+		void draw(const ofShader &shader);
+	};
+
+	Batch joints, bones, axes;
+	ofShader shader;
+};
@@ -0,0 +1,274 @@
+//
+//  AnimationWorker.cpp - animation evaluation on a dedicated thread
+//
+
+#include "AnimationWorker.h"
+#include "SceneGraph.h"
+#include "Profiler.h"
+#include <algorithm>
+
+void AnimationWorker::start() {
+	if (thread.joinable()) return;
+	bStop = false;
+	thread = std::thread(&AnimationWorker::run, this);
+}
+
+void AnimationWorker::stop() {
+	if (!thread.joinable()) return;
+	{
+		std::lock_guard<std::mutex> lock(mutex);
+		bStop = true;
+	}
+	wake.notify_one();
+	thread.join();
+}
+
+void AnimationWorker::post(Command command, bool bEdit) {
+	if (bEdit) {
+		postedEdits++;
+		Command edit = std::move(command);
+		command = [edit](Rig &rig) {
+			edit(rig);
+			rig.editCount++;
+		};
+	}
+	{
+		std::lock_guard<std::mutex> lock(mutex);
+		commands.push_back(std::move(command));
+	}
+	wake.notify_one();
+}
+
+// The proxies are created here, on the UI thread, while the scene objects are
+// not being changed.  Every slot gets a Joint; objects that are not joints
+// simply have no keys.
+//
+void AnimationWorker::rebuild(const SkeletonPose &pose, int frameBegin, int frameEnd) {
+	auto proxies = std::make_shared<std::vector<std::unique_ptr<Joint>>>(pose.size());
+	for (int i = 0; i < pose.size(); i++) {
+		const SceneObject *obj = pose.objects[i];
+		Joint *proxy = new Joint(obj->name, 1.0f);
+		proxy->position = obj->position;
+		proxy->rotation = obj->rotation;
+		proxy->orientation = obj->orientation;
+		proxy->bQuatRotation = obj->bQuatRotation;
+		proxy->scale = obj->scale;
+		proxy->pivot = obj->pivot;
+		const Joint *joint = dynamic_cast<const Joint *>(obj);
+		if (joint) proxy->keyFrames = joint->keyFrames;
+		if (pose.parent[i] >= 0) (*proxies)[pose.parent[i]]->addChild(proxy);
+		(*proxies)[i].reset(proxy);
+	}
+
+	post([proxies, frameBegin, frameEnd](Rig &rig) {
+		rig.proxies = std::move(*proxies);
+		rig.scene.clear();
+		for (auto &proxy : rig.proxies) rig.scene.push_back(proxy.get());
+		rig.pose.build(rig.scene);
+		rig.frameBegin = frameBegin;
+		rig.frameEnd = frameEnd;
+		rig.bCacheStale = true;
+		rig.bShowFrame = true;
+	}, true);
+}
+
+void AnimationWorker::setFrame(int frame) {
+	post([frame](Rig &rig) {
+		rig.frame = frame;
+		rig.bShowFrame = true;
+	}, false);
+}
+
+void AnimationWorker::setInterpolation(bool bEase, bool bSlerp) {
+	post([bEase, bSlerp](Rig &rig) {
+		rig.bEase = bEase;
+		rig.bSlerp = bSlerp;
+		rig.cache.invalidate();
+	}, true);
+}
+
+// a key was set or deleted at frame.  Only the frames between the neighbouring
+// keys need to be baked again, unless the joint started or stopped being animated.
+// returns false in that case (the cache must be set up again), otherwise widens
+// [from, to] by the frames to invalidate.
+//
+bool AnimationWorker::keyRange(Rig &rig, int slot, int frame, int &from, int &to) {
+	Joint *joint = rig.proxies[slot].get();
+	joint->keyCursor = 0;
+	if (joint->keyFrames.size() < 2 || !rig.cache.isAnimated(slot)) return false;
+	int before = rig.frameBegin;
+	int after = rig.frameEnd;
+	for (const auto &kf : joint->keyFrames) {
+		if (kf.frame < frame) before = kf.frame;
+		else if (kf.frame > frame) {
+			after = kf.frame;
+			break;
+		}
+	}
+	from = std::min(from, before);
+	to = std::max(to, after);
+	return true;
+}
+
+// the keys of slots were edited at frame: invalidate the union of their ranges once
+//
+void AnimationWorker::invalidateKeys(Rig &rig, const std::vector<int> &slots, int frame) {
+	int from = rig.frameEnd + 1;
+	int to = rig.frameBegin - 1;
+	bool bStale = false;
+	for (int slot : slots) {
+		if (!keyRange(rig, slot, frame, from, to)) bStale = true;
+	}
+	if (bStale) rig.bCacheStale = true;
+	else if (from <= to) rig.cache.invalidateRange(from, to);
+}
+
+void AnimationWorker::setKeys(int slot, const std::vector<KeyFrame> &keys, int frame) {
+	if (slot < 0) return;
+	post([slot, keys, frame](Rig &rig) {
+		if (slot >= (int)rig.proxies.size()) return;
+		rig.proxies[slot]->keyFrames = keys;
+		invalidateKeys(rig, std::vector<int>(1, slot), frame);
+	}, true);
+}
+
+void AnimationWorker::setKey(const std::vector<int> &slots, const std::vector<KeyFrame> &keys) {
+	if (slots.empty()) return;
+	post([slots, keys](Rig &rig) {
+		std::vector<int> edited;
+		edited.reserve(slots.size());
+		for (size_t i = 0; i < slots.size(); i++) {
+			int slot = slots[i];
+			if (slot < 0 || slot >= (int)rig.proxies.size()) continue;
+			rig.proxies[slot]->setKey(keys[i]);
+			edited.push_back(slot);
+		}
+		invalidateKeys(rig, edited, keys[0].frame);
+	}, true);
+}
+
+void AnimationWorker::deleteKey(const std::vector<int> &slots, int frame) {
+	if (slots.empty()) return;
+	post([slots, frame](Rig &rig) {
+		std::vector<int> edited;
+		for (int slot : slots) {
+			if (slot < 0 || slot >= (int)rig.proxies.size()) continue;
+			if (rig.proxies[slot]->deleteKey(frame)) edited.push_back(slot);
+		}
+		invalidateKeys(rig, edited, frame);
+	}, true);
+}
+
+// the rest pose of the objects changed.  Only the baked world matrices of
+// their subtrees depend on it (see PoseCache::updateChannels()).
+//
+void AnimationWorker::setChannels(int slot, const SceneObject *obj) {
+	if (slot < 0) return;
+	postChannels(std::vector<Channels>(1, Channels{ slot, obj->position, obj->rotation, obj->orientation, obj->bQuatRotation, obj->scale }));
+}
+
+void AnimationWorker::setChannels(const std::vector<int> &slots, const std::vector<SceneObject *> &objects) {
+	std::vector<Channels> channels;
+	channels.reserve(slots.size());
+	for (size_t i = 0; i < slots.size(); i++) {
+		if (slots[i] < 0) continue;
+		const SceneObject *obj = objects[i];
+		channels.push_back({ slots[i], obj->position, obj->rotation, obj->orientation, obj->bQuatRotation, obj->scale });
+	}
+	if (!channels.empty()) postChannels(channels);
+}
+
+void AnimationWorker::postChannels(const std::vector<Channels> &channels) {
+	post([channels](Rig &rig) {
+		std::vector<int> edited;
+		bool bResample = false;
+		for (const Channels &c : channels) {
+			if (c.slot >= (int)rig.proxies.size()) continue;
+			Joint *proxy = rig.proxies[c.slot].get();
+
+			// the keys of an animated joint are sampled in its rotation mode
+			//
+			if (proxy->bQuatRotation != c.bQuatRotation && rig.cache.isAnimated(c.slot)) bResample = true;
+			proxy->position = c.position;
+			proxy->rotation = c.rotation;
+			proxy->orientation = c.orientation;
+			proxy->bQuatRotation = c.bQuatRotation;
+			proxy->scale = c.scale;
+			proxy->markDirty();
+			edited.push_back(c.slot);
+		}
+		if (rig.bCacheStale) return;
+		if (bResample) rig.cache.invalidate();
+		else rig.cache.updateChannels(rig.pose, edited);
+	}, true);
+}
+
+const PoseSnapshot *AnimationWorker::latest() {
+	return (snapshots.update() ? &snapshots.front() : NULL);
+}
+
+// wait for commands, apply all that are queued, then evaluate once.
+// a burst of edits (e.g. a mouse drag) therefore costs a single evaluation.
+//
+void AnimationWorker::run() {
+	std::vector<Command> batch;
+	for (;;) {
+		{
+			std::unique_lock<std::mutex> lock(mutex);
+			wake.wait(lock, [this] { return bStop || !commands.empty(); });
+			if (bStop) return;
+			batch.assign(std::make_move_iterator(commands.begin()), std::make_move_iterator(commands.end()));
+			commands.clear();
+		}
+		for (auto &command : batch) command(rig);
+		batch.clear();
+		evaluate();
+	}
+}
+
+// After a frame change: same as the old ofApp::showFrame(), i.e. bake what is
+// invalid, then copy the frame out of the cache (frames outside the playback
+// range keep the current channels).  Edits alone do not jump back to the keyed pose,
+// so a keyed joint can be dragged and then keyed again; the pose is just
+// recomputed from the current channels.
+//
+void AnimationWorker::evaluate() {
+	PROFILE_SCOPE("evaluate");
+	SkeletonPose &pose = rig.pose;
+	if (rig.bCacheStale) {
+		bool bWorld = PoseCache::worldBytes(pose.size(), rig.frameBegin, rig.frameEnd) <= WORLD_CACHE_BYTES;
+		rig.cache.setup(pose, rig.frameBegin, rig.frameEnd, bWorld);
+		rig.bCacheStale = false;
+	}
+	bool bApplied = false;
+	if (rig.bShowFrame) {
+		rig.cache.bake(pose, rig.bEase, rig.bSlerp);
+		bApplied = rig.cache.apply(rig.frame, pose);
+		rig.bShowFrame = false;
+	}
+	if (!bApplied) {
+		pose.pull();
+		pose.computeWorld();
+		pose.push();
+	}
+
+	PoseSnapshot &snapshot = snapshots.back();
+	int n = pose.size();
+	snapshot.frame = rig.frame;
+	snapshot.editCount = rig.editCount;
+	snapshot.animated.resize(n);
+	snapshot.position.resize(n);
+	snapshot.rotation.resize(n);
+	snapshot.orientation.resize(n);
+	snapshot.scale.resize(n);
+	snapshot.world.assign(pose.world.begin(), pose.world.end());
+	for (int i = 0; i < n; i++) {
+		const SceneObject *proxy = pose.objects[i];
+		snapshot.animated[i] = rig.cache.isAnimated(i);
+		snapshot.position[i] = proxy->position;
+		snapshot.rotation[i] = proxy->rotation;
+		snapshot.orientation[i] = proxy->orientation;
+		snapshot.scale[i] = proxy->scale;
+	}
+	snapshots.publish();
+}
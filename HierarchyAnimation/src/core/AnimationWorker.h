@@ -0,0 +1,140 @@
+//
+//  AnimationWorker.h - animation evaluation on a dedicated thread
+//
+//  The worker owns a private copy of the animated hierarchy (one proxy Joint per
+//  SkeletonPose slot) together with its own SkeletonPose and PoseCache, so it never
+//  touches the scene objects that are being edited and drawn.
+//
+//  The UI thread hands over edits (frame changes, keys, dragged channels, a rebuilt
+//  hierarchy) through a command queue.  The worker drains the queue, evaluates the
+//  current frame and publishes the finished pose through a lock-free triple buffer.
+//  ofApp::draw() takes the latest complete pose without ever waiting on the worker.
+//
+#pragma once
+
+#include <vector>
+#include <deque>
+#include <memory>
+#include <functional>
+#include <thread>
+#include <mutex>
+#include <condition_variable>
+#include "glm/glm.hpp"
+#include "glm/gtc/quaternion.hpp"
+#include "KeyFrame.h"
+#include "SkeletonPose.h"
+#include "PoseCache.h"
+#include "TripleBuffer.h"
+
+class SceneObject;
+class Joint;
+
+// one evaluated pose, indexed by SkeletonPose slot
+//
+struct PoseSnapshot {
+	int frame = 0;
+	unsigned int editCount = 0;     // number of edit commands evaluated into this pose
+
+	std::vector<unsigned char> animated;    // 1 => channels below come from the keys
+	std::vector<glm::vec3> position;
+	std::vector<glm::vec3> rotation;        // Euler degrees
+	std::vector<glm::quat> orientation;
+	std::vector<glm::vec3> scale;
+	std::vector<glm::mat4> world;
+};
+
+class AnimationWorker {
+public:
+	~AnimationWorker() { stop(); }
+
+	void start();
+	void stop();
+
+	// commands (UI thread).  slot is the SkeletonPose slot of the edited object.
+	//
+
+	// copy the hierarchy of pose (already built from the scene) and its playback range
+	//
+	void rebuild(const SkeletonPose &pose, int frameBegin, int frameEnd);
+
+	void setFrame(int frame);
+	void setInterpolation(bool bEase, bool bSlerp);
+
+	// replace the keys of a joint; frame is the key that was set or deleted
+	//
+	void setKeys(int slot, const std::vector<KeyFrame> &keys, int frame);
+
+	// copy the transform channels (and rotation mode) of obj
+	//
+	void setChannels(int slot, const SceneObject *obj);
+
+	// batches for multi-object edits: one command however many objects are
+	// selected.  setKey() sets keys[i] on slots[i], deleteKey() removes the key
+	// at frame from every slot that has one; the worker edits its proxies the
+	// same way, so the key lists are not copied.
+	//
+	void setKey(const std::vector<int> &slots, const std::vector<KeyFrame> &keys);
+	void deleteKey(const std::vector<int> &slots, int frame);
+	void setChannels(const std::vector<int> &slots, const std::vector<SceneObject *> &objects);
+
+	// latest published pose (UI thread).  returns NULL if nothing new was
+	// published since the last call.  A pose is only complete for the current
+	// scene once editCount() edits have been evaluated into it.
+	//
+	const PoseSnapshot *latest();
+
+	unsigned int editCount() const { return postedEdits; }
+
+private:
+	// worker side state; only touched by commands and evaluate()
+	//
+	struct Rig {
+		std::vector<std::unique_ptr<Joint>> proxies;
+		std::vector<SceneObject *> scene;
+		SkeletonPose pose;
+		PoseCache cache;
+		bool bCacheStale = true;
+		bool bShowFrame = true;       // frame changed => copy it out of the cache
+		int frameBegin = 1;
+		int frameEnd = 0;
+		int frame = 1;
+		bool bEase = false;
+		bool bSlerp = false;
+		unsigned int editCount = 0;
+	};
+	typedef std::function<void(Rig &)> Command;
+
+	// transform channels of one object, as copied by setChannels()
+	//
+	struct Channels {
+		int slot;
+		glm::vec3 position;
+		glm::vec3 rotation;
+		glm::quat orientation;
+		bool bQuatRotation;
+		glm::vec3 scale;
+	};
+
+	void postChannels(const std::vector<Channels> &channels);
+	static bool keyRange(Rig &rig, int slot, int frame, int &from, int &to);
+	static void invalidateKeys(Rig &rig, const std::vector<int> &slots, int frame);
+
+	// world matrices are only baked while they fit (see PoseCache::worldBytes());
+	// larger scenes cache the channels and rebuild the pose when a frame is shown
+	//
+	static const size_t WORLD_CACHE_BYTES = 64 * 1024 * 1024;
+
+	void post(Command command, bool bEdit);
+	void run();
+	void evaluate();
+
+	Rig rig;
+	TripleBuffer<PoseSnapshot> snapshots;
+
+	std::thread thread;
+	std::mutex mutex;
+	std::condition_variable wake;
+	std::deque<Command> commands;      // guarded by mutex
+	bool bStop = false;                // guarded by mutex
+	unsigned int postedEdits = 0;      // UI thread only
+};
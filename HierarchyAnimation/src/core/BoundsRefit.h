@@ -0,0 +1,43 @@
+//
+//  BoundsRefit.h - incremental refit of a box tree over moving scene objects
+//
+//  SceneBVH (picking) and SceneCuller (frustum culling) both keep a world space
+//  box per object, computed for a given SceneObject::worldVersion, under a tree
+//  of boxes stored parents first.  As objects move, only their boxes and the
+//  nodes above them are recomputed.
+//
+#pragma once
+
+#include <vector>
+
+//  Item has obj (a SceneObject *) and version, Node has parent (an earlier
+//  node, -1 for a root).  For every item whose object's world matrix changed,
+//  computeItem(i) recomputes its box and returns the node that holds it; that
+//  node and its ancestors are marked in dirty (one entry per node, all 0 between
+//  calls) and refit bottom up with fitNode(n).
+//
+template <class Item, class Node, class ComputeItem, class FitNode>
+void refitBounds(std::vector<Item> &items, const std::vector<Node> &nodes, std::vector<unsigned char> &dirty,
+	ComputeItem computeItem, FitNode fitNode) {
+
+	bool bChanged = false;
+	for (int i = 0; i < (int)items.size(); i++) {
+		Item &item = items[i];
+		item.obj->getMatrix();    // rebuilds the world matrix if it is stale
+		if (item.obj->worldVersion == item.version) continue;
+
+		for (int n = computeItem(i); n >= 0 && !dirty[n]; n = nodes[n].parent) {
+			dirty[n] = 1;
+		}
+		bChanged = true;
+	}
+	if (!bChanged) return;
+
+	// children always come after their parent, so a reverse walk refits bottom up
+	//
+	for (int n = (int)nodes.size() - 1; n >= 0; n--) {
+		if (!dirty[n]) continue;
+		fitNode(n);
+		dirty[n] = 0;
+	}
+}
@@ -0,0 +1,244 @@
+//
+//  BoxKernels.cpp - one ray against many axis aligned boxes
+//
+
+#include "BoxKernels.h"
+#include "KernelDispatch.h"
+#include <cstring>
+#include <cmath>
+#include <limits>
+
+void BoxPackets::clear() {
+	for (int axis = 0; axis < 3; axis++) {
+		lo[axis].clear();
+		hi[axis].clear();
+	}
+	count = 0;
+}
+
+void BoxPackets::resize(int n) {
+	count = n;
+	for (int axis = 0; axis < 3; axis++) {
+		lo[axis].resize(n + BOX_PACKET, 0.0f);
+		hi[axis].resize(n + BOX_PACKET, 0.0f);
+	}
+}
+
+void BoxPackets::set(int i, const glm::vec3 &boundsMin, const glm::vec3 &boundsMax) {
+	for (int axis = 0; axis < 3; axis++) {
+		lo[axis][i] = boundsMin[axis];
+		hi[axis][i] = boundsMax[axis];
+	}
+}
+
+
+//--------------------------------------------------------------
+// scalar reference
+//
+// min/max are written like minps/maxps, so all kernels agree bit for bit
+//
+
+static inline float minSlab(float a, float b) { return (a < b ? a : b); }
+static inline float maxSlab(float a, float b) { return (a > b ? a : b); }
+
+static unsigned intersectScalar(const BoxPackets &boxes, int first, const glm::vec3 &origin, const glm::vec3 &invDir,
+	float tMin, float tMax, float *tEntry) {
+
+	unsigned mask = 0;
+	for (int i = 0; i < BOX_PACKET; i++) {
+		float tNear = tMin, tFar = tMax;
+		for (int axis = 0; axis < 3; axis++) {
+			float t0 = (boxes.min(axis)[first + i] - origin[axis]) * invDir[axis];
+			float t1 = (boxes.max(axis)[first + i] - origin[axis]) * invDir[axis];
+			tNear = maxSlab(minSlab(t0, t1), tNear);
+			tFar = minSlab(maxSlab(t0, t1), tFar);
+		}
+		tEntry[i] = tNear;
+		if (tNear <= tFar) mask |= (1u << i);
+	}
+	return mask;
+}
+
+// corner of the box furthest along the plane normal, one array per axis
+//
+static inline const float *farCorner(const BoxPackets &boxes, const glm::vec4 &plane, int axis) {
+	return (plane[axis] >= 0 ? boxes.max(axis) : boxes.min(axis));
+}
+
+static unsigned insideFrustumScalar(const BoxPackets &boxes, int first, const glm::vec4 *planes) {
+	unsigned mask = (1u << BOX_PACKET) - 1;
+	for (int p = 0; p < 6; p++) {
+		const glm::vec4 &plane = planes[p];
+		const float *x = farCorner(boxes, plane, 0) + first;
+		const float *y = farCorner(boxes, plane, 1) + first;
+		const float *z = farCorner(boxes, plane, 2) + first;
+		for (int i = 0; i < BOX_PACKET; i++) {
+			if ((plane.x * x[i] + plane.y * y[i]) + (plane.z * z[i] + plane.w) < 0) mask &= ~(1u << i);
+		}
+	}
+	return mask;
+}
+
+static const BoxKernel scalarKernel = { "scalar", intersectScalar, insideFrustumScalar };
+
+
+#ifdef KERNELS_X86
+
+//--------------------------------------------------------------
+// SSE: the packet as two halves of 4 boxes
+//
+
+static unsigned intersectSSE(const BoxPackets &boxes, int first, const glm::vec3 &origin, const glm::vec3 &invDir,
+	float tMin, float tMax, float *tEntry) {
+
+	unsigned mask = 0;
+	for (int half = 0; half < BOX_PACKET; half += 4) {
+		__m128 tNear = _mm_set1_ps(tMin);
+		__m128 tFar = _mm_set1_ps(tMax);
+		for (int axis = 0; axis < 3; axis++) {
+			__m128 o = _mm_set1_ps(origin[axis]);
+			__m128 inv = _mm_set1_ps(invDir[axis]);
+			__m128 t0 = _mm_mul_ps(_mm_sub_ps(_mm_loadu_ps(boxes.min(axis) + first + half), o), inv);
+			__m128 t1 = _mm_mul_ps(_mm_sub_ps(_mm_loadu_ps(boxes.max(axis) + first + half), o), inv);
+			tNear = _mm_max_ps(_mm_min_ps(t0, t1), tNear);
+			tFar = _mm_min_ps(_mm_max_ps(t0, t1), tFar);
+		}
+		_mm_storeu_ps(tEntry + half, tNear);
+		mask |= (unsigned)_mm_movemask_ps(_mm_cmple_ps(tNear, tFar)) << half;
+	}
+	return mask;
+}
+
+static unsigned insideFrustumSSE(const BoxPackets &boxes, int first, const glm::vec4 *planes) {
+	unsigned mask = 0;
+	for (int half = 0; half < BOX_PACKET; half += 4) {
+		__m128 outside = _mm_setzero_ps();
+		for (int p = 0; p < 6; p++) {
+			const glm::vec4 &plane = planes[p];
+			__m128 d = _mm_add_ps(_mm_mul_ps(_mm_set1_ps(plane.x), _mm_loadu_ps(farCorner(boxes, plane, 0) + first + half)),
+				_mm_mul_ps(_mm_set1_ps(plane.y), _mm_loadu_ps(farCorner(boxes, plane, 1) + first + half)));
+			d = _mm_add_ps(d, _mm_add_ps(_mm_mul_ps(_mm_set1_ps(plane.z), _mm_loadu_ps(farCorner(boxes, plane, 2) + first + half)),
+				_mm_set1_ps(plane.w)));
+			outside = _mm_or_ps(outside, _mm_cmplt_ps(d, _mm_setzero_ps()));
+		}
+		mask |= (unsigned)(~_mm_movemask_ps(outside) & 0xf) << half;
+	}
+	return mask;
+}
+
+static const BoxKernel sseKernel = { "sse", intersectSSE, insideFrustumSSE };
+
+
+//--------------------------------------------------------------
+// AVX2: the whole packet in one register per bound
+//
+
+KERNEL_TARGET_AVX2
+static unsigned intersectAVX2(const BoxPackets &boxes, int first, const glm::vec3 &origin, const glm::vec3 &invDir,
+	float tMin, float tMax, float *tEntry) {
+
+	__m256 tNear = _mm256_set1_ps(tMin);
+	__m256 tFar = _mm256_set1_ps(tMax);
+	for (int axis = 0; axis < 3; axis++) {
+		__m256 o = _mm256_set1_ps(origin[axis]);
+		__m256 inv = _mm256_set1_ps(invDir[axis]);
+		__m256 t0 = _mm256_mul_ps(_mm256_sub_ps(_mm256_loadu_ps(boxes.min(axis) + first), o), inv);
+		__m256 t1 = _mm256_mul_ps(_mm256_sub_ps(_mm256_loadu_ps(boxes.max(axis) + first), o), inv);
+		tNear = _mm256_max_ps(_mm256_min_ps(t0, t1), tNear);
+		tFar = _mm256_min_ps(_mm256_max_ps(t0, t1), tFar);
+	}
+	_mm256_storeu_ps(tEntry, tNear);
+	return (unsigned)_mm256_movemask_ps(_mm256_cmp_ps(tNear, tFar, _CMP_LE_OQ));
+}
+
+KERNEL_TARGET_AVX2
+static unsigned insideFrustumAVX2(const BoxPackets &boxes, int first, const glm::vec4 *planes) {
+	__m256 outside = _mm256_setzero_ps();
+	for (int p = 0; p < 6; p++) {
+		const glm::vec4 &plane = planes[p];
+		__m256 d = _mm256_add_ps(_mm256_mul_ps(_mm256_set1_ps(plane.x), _mm256_loadu_ps(farCorner(boxes, plane, 0) + first)),
+			_mm256_mul_ps(_mm256_set1_ps(plane.y), _mm256_loadu_ps(farCorner(boxes, plane, 1) + first)));
+		d = _mm256_add_ps(d, _mm256_add_ps(_mm256_mul_ps(_mm256_set1_ps(plane.z), _mm256_loadu_ps(farCorner(boxes, plane, 2) + first)),
+			_mm256_set1_ps(plane.w)));
+		outside = _mm256_or_ps(outside, _mm256_cmp_ps(d, _mm256_setzero_ps(), _CMP_LT_OQ));
+	}
+	return ~(unsigned)_mm256_movemask_ps(outside) & 0xff;
+}
+
+static const BoxKernel avx2Kernel = { "avx2", intersectAVX2, insideFrustumAVX2 };
+
+#endif // KERNELS_X86
+
+
+//--------------------------------------------------------------
+//
+static const BoxKernel *const kernels[KERNEL_LEVELS] = {
+	&scalarKernel, KERNEL_X86(&sseKernel), KERNEL_X86(&avx2Kernel)
+};
+
+const BoxKernel *boxKernelByName(const char *name) {
+	return kernelByName(kernels, name);
+}
+
+const BoxKernel &boxKernel() {
+	static const BoxKernel &best = bestKernel(kernels);
+	return best;
+}
+
+//--------------------------------------------------------------
+//
+bool nearestBox(const BoxPackets &boxes, int begin, int end, const glm::vec3 &origin, const glm::vec3 &direction,
+	float tMax, RayBoxHit &hit) {
+
+	const BoxKernel &kernel = boxKernel();
+	glm::vec3 invDir = rayInverse(direction);
+	float tEntry[BOX_PACKET];
+	hit.index = -1;
+	hit.t = tMax;
+	if (end > boxes.size()) end = boxes.size();
+
+	for (int first = begin; first < end; first += BOX_PACKET) {
+		unsigned mask = kernel.intersect(boxes, first, origin, invDir, 0, hit.t, tEntry);
+		if (end - first < BOX_PACKET) mask &= (1u << (end - first)) - 1;
+		for (int i = 0; mask; i++, mask >>= 1) {
+			if ((mask & 1) && (hit.index < 0 || tEntry[i] < hit.t)) {
+				hit.t = tEntry[i];
+				hit.index = first + i;
+			}
+		}
+	}
+	if (hit.index < 0) return false;
+
+	if (hit.t > 0) hit.normal = boxFaceNormal(origin + direction * hit.t, boxes.getMin(hit.index), boxes.getMax(hit.index));
+	else hit.normal = glm::vec3(0);
+	return true;
+}
+
+int boxesInFrustum(const BoxPackets &boxes, const glm::vec4 *planes, std::vector<int> &inside) {
+	const BoxKernel &kernel = boxKernel();
+	int found = 0;
+	for (int first = 0; first < boxes.size(); first += BOX_PACKET) {
+		unsigned mask = kernel.insideFrustum(boxes, first, planes);
+		if (boxes.size() - first < BOX_PACKET) mask &= (1u << (boxes.size() - first)) - 1;
+		for (int i = 0; mask; i++, mask >>= 1) {
+			if (!(mask & 1)) continue;
+			inside.push_back(first + i);
+			found++;
+		}
+	}
+	return found;
+}
+
+glm::vec3 boxFaceNormal(const glm::vec3 &point, const glm::vec3 &boundsMin, const glm::vec3 &boundsMax) {
+	int axis = 0;
+	float sign = -1, nearest = std::numeric_limits<float>::infinity();
+	for (int i = 0; i < 3; i++) {
+		float dMin = std::fabs(point[i] - boundsMin[i]);
+		float dMax = std::fabs(point[i] - boundsMax[i]);
+		if (dMin < nearest) { nearest = dMin; axis = i; sign = -1; }
+		if (dMax < nearest) { nearest = dMax; axis = i; sign = 1; }
+	}
+	glm::vec3 normal(0);
+	normal[axis] = sign;
+	return normal;
+}
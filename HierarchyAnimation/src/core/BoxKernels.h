@@ -0,0 +1,100 @@
+//
+//  BoxKernels.h - one ray against many axis aligned boxes
+//
+//  Boxes are stored structure of arrays (BoxPackets): one float array per bound
+//  and axis, so a packet of BOX_PACKET consecutive boxes loads into a few SIMD
+//  registers and the slab test runs on all of them at once.  The kernel returns
+//  a mask of the boxes hit and their entry t; nearestBox() builds on it to find
+//  the nearest box and the face the ray enters through.  insideFrustum() tests a
+//  packet against the six planes of a view volume the same way (culling, marquee
+//  selection of object positions stored as zero size boxes).
+//
+//  Scalar, SSE and AVX2 versions; see KernelDispatch.h for how one is picked.
+//
+#pragma once
+
+#include <vector>
+#include <cmath>
+#include "glm/glm.hpp"
+
+static const int BOX_PACKET = 8;      // boxes per kernel call
+
+class BoxPackets {
+public:
+	void clear();
+	void resize(int count);
+	void set(int i, const glm::vec3 &boundsMin, const glm::vec3 &boundsMax);
+	glm::vec3 getMin(int i) const { return glm::vec3(lo[0][i], lo[1][i], lo[2][i]); }
+	glm::vec3 getMax(int i) const { return glm::vec3(hi[0][i], hi[1][i], hi[2][i]); }
+	int size() const { return count; }
+
+	// the arrays have BOX_PACKET floats of padding after the last box, so a
+	// packet can start at any index < size()
+	//
+	const float *min(int axis) const { return lo[axis].data(); }
+	const float *max(int axis) const { return hi[axis].data(); }
+
+private:
+	std::vector<float> lo[3], hi[3];
+	int count = 0;
+};
+
+// 1 / direction for the slab tests.  zero components are replaced by a tiny value
+// of the same sign, so a ray in the plane of a face never computes 0 * inf = NaN.
+//
+inline glm::vec3 rayInverse(const glm::vec3 &direction) {
+	glm::vec3 inv;
+	for (int i = 0; i < 3; i++) {
+		float d = direction[i];
+		inv[i] = 1.0f / (std::fabs(d) > 1e-20f ? d : std::copysign(1e-20f, d));
+	}
+	return inv;
+}
+
+struct BoxKernel {
+	const char *name;
+
+	// slab test of the ray (origin, rayInverse(direction)) against boxes [first, first + BOX_PACKET).
+	// returns a mask with bit i set if box first + i is hit with t in [tMin, tMax];
+	// tEntry[i] then holds the t where the ray enters it (tMin if it starts inside).
+	// bits of boxes past size() are garbage, the caller masks them.
+	//
+	unsigned (*intersect)(const BoxPackets &boxes, int first, const glm::vec3 &origin, const glm::vec3 &invDir,
+		float tMin, float tMax, float *tEntry);
+
+	// boxes [first, first + BOX_PACKET) against 6 planes (a, b, c, d) pointing
+	// inwards.  bit i is set unless box first + i is completely outside a plane
+	// (the corner furthest along the plane normal is tested, see Frustum).
+	//
+	unsigned (*insideFrustum)(const BoxPackets &boxes, int first, const glm::vec4 *planes);
+};
+
+// best kernel for this CPU (selected once, on first use)
+//
+const BoxKernel &boxKernel();
+
+// look up a kernel by name ("scalar", "sse", "avx2").
+// returns NULL if it is not compiled in or not supported by this CPU.
+//
+const BoxKernel *boxKernelByName(const char *name);
+
+struct RayBoxHit {
+	int index;            // box
+	float t;              // entry point along the ray
+	glm::vec3 normal;     // outward normal of the face entered, 0 if the ray starts inside
+};
+
+// nearest of boxes [begin, end) hit by the ray with t in [0, tMax].
+// returns false if none is hit.
+//
+bool nearestBox(const BoxPackets &boxes, int begin, int end, const glm::vec3 &origin, const glm::vec3 &direction,
+	float tMax, RayBoxHit &hit);
+
+// indices of boxes [0, size()) not outside the 6 planes (see insideFrustum()),
+// appended to inside.  returns the number found.
+//
+int boxesInFrustum(const BoxPackets &boxes, const glm::vec4 *planes, std::vector<int> &inside);
+
+// outward normal of the box face a point on its surface lies on
+//
+glm::vec3 boxFaceNormal(const glm::vec3 &point, const glm::vec3 &boundsMin, const glm::vec3 &boundsMax);
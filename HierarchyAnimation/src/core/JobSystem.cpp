@@ -0,0 +1,120 @@
+//
+//  JobSystem.cpp - work-stealing thread pool for pose evaluation
+//
+
+#include "JobSystem.h"
+#include <algorithm>
+
+// index of this thread's own queue; 0 for threads outside the pool
+//
+static thread_local int queueIndex = 0;
+
+JobSystem::JobSystem(int threadCount) {
+	threadCount = std::max(threadCount, 1);
+	for (int i = 0; i < threadCount; i++) {
+		queues.emplace_back(new Queue);
+	}
+	for (int i = 1; i < threadCount; i++) {
+		threads.emplace_back(&JobSystem::workerLoop, this, i);
+	}
+}
+
+JobSystem::~JobSystem() {
+	{
+		std::lock_guard<std::mutex> lock(sleepMutex);
+		bStop = true;
+	}
+	wake.notify_all();
+	for (auto &thread : threads) thread.join();
+}
+
+// own queue from the back (most recently pushed, still in cache),
+// then the other queues from the front
+//
+bool JobSystem::popJob(int self, Job &job) {
+	{
+		Queue &own = *queues[self];
+		std::lock_guard<std::mutex> lock(own.mutex);
+		if (!own.jobs.empty()) {
+			job = own.jobs.back();
+			own.jobs.pop_back();
+			queued--;
+			return true;
+		}
+	}
+	int n = (int)queues.size();
+	for (int i = 1; i < n; i++) {
+		Queue &victim = *queues[(self + i) % n];
+		std::lock_guard<std::mutex> lock(victim.mutex);
+		if (!victim.jobs.empty()) {
+			job = victim.jobs.front();
+			victim.jobs.pop_front();
+			queued--;
+			return true;
+		}
+	}
+	return false;
+}
+
+void JobSystem::runJob(const Job &job) {
+	(*job.body)(job.begin, job.end);
+	job.pending->fetch_sub(1, std::memory_order_acq_rel);
+}
+
+void JobSystem::workerLoop(int self) {
+	queueIndex = self;
+	Job job;
+	for (;;) {
+		if (popJob(self, job)) {
+			runJob(job);
+			continue;
+		}
+		std::unique_lock<std::mutex> lock(sleepMutex);
+		wake.wait(lock, [this] { return bStop || queued.load() > 0; });
+		if (bStop) return;
+	}
+}
+
+// chunks are dealt round robin over all queues, so every thread starts on
+// its own share; whoever runs out early steals from the rest.
+//
+void JobSystem::parallelFor(int count, int grain, const std::function<void(int, int)> &body) {
+	if (count <= 0) return;
+	grain = std::max(grain, 1);
+	int chunks = (count + grain - 1) / grain;
+	if (chunks == 1 || threads.empty()) {
+		for (int begin = 0; begin < count; begin += grain) {
+			body(begin, std::min(begin + grain, count));
+		}
+		return;
+	}
+
+	std::atomic<int> pending(chunks);
+	int n = (int)queues.size();
+	int first = queueIndex;
+	for (int k = 0; k < chunks; k++) {
+		Job job = { &body, k * grain, std::min((k + 1) * grain, count), &pending };
+		Queue &queue = *queues[(first + k) % n];
+		std::lock_guard<std::mutex> lock(queue.mutex);
+		queue.jobs.push_back(job);
+		queued++;
+	}
+	{
+		std::lock_guard<std::mutex> lock(sleepMutex);
+	}
+	wake.notify_all();
+
+	// help until our chunks are done.  Jobs of other callers may be picked up
+	// too; that is fine, they are independent.
+	//
+	Job job;
+	while (pending.load(std::memory_order_acquire) > 0) {
+		if (popJob(first, job)) runJob(job);
+		else std::this_thread::yield();
+	}
+}
+
+JobSystem &jobSystem() {
+	static JobSystem jobs((int)std::max(std::thread::hardware_concurrency(), 1u));
+	return jobs;
+}
@@ -0,0 +1,66 @@
+//
+//  JobSystem.h - work-stealing thread pool for pose evaluation
+//
+//  Every worker thread owns a deque of jobs.  A thread pops jobs from the back of
+//  its own deque and, when that is empty, steals from the front of the others, so
+//  uneven work (e.g. rigs of very different size) balances itself.
+//
+//  parallelFor() splits [0, count) into fixed chunks of grain items.  The chunks
+//  depend only on count and grain, never on the number of threads, so any result
+//  computed per chunk is the same whichever thread runs it.  The calling thread
+//  works on the jobs too and returns once all chunks are done.
+//
+#pragma once
+
+#include <vector>
+#include <deque>
+#include <memory>
+#include <functional>
+#include <atomic>
+#include <thread>
+#include <mutex>
+#include <condition_variable>
+
+class JobSystem {
+public:
+
+	// threadCount includes the calling thread; 1 => everything runs inline
+	//
+	explicit JobSystem(int threadCount);
+	~JobSystem();
+
+	int threadCount() const { return (int)threads.size() + 1; }
+
+	// run body(begin, end) for the chunks [k * grain, min((k + 1) * grain, count))
+	//
+	void parallelFor(int count, int grain, const std::function<void(int, int)> &body);
+
+private:
+	struct Job {
+		const std::function<void(int, int)> *body;
+		int begin, end;
+		std::atomic<int> *pending;
+	};
+	struct Queue {
+		std::mutex mutex;
+		std::deque<Job> jobs;
+	};
+
+	bool popJob(int self, Job &job);
+	void runJob(const Job &job);
+	void workerLoop(int self);
+
+	// queues[0] is shared by all threads outside the pool
+	//
+	std::vector<std::unique_ptr<Queue>> queues;
+	std::vector<std::thread> threads;
+
+	std::atomic<int> queued{ 0 };      // jobs sitting in any queue
+	std::mutex sleepMutex;
+	std::condition_variable wake;
+	bool bStop = false;                // guarded by sleepMutex
+};
+
+// pool with one thread per core (created on first use)
+//
+JobSystem &jobSystem();
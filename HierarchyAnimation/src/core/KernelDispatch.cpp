@@ -0,0 +1,52 @@
+//
+//  KernelDispatch.cpp - runtime selection of the SIMD kernel families
+//
+
+#include "KernelDispatch.h"
+
+#if defined(KERNELS_X86) && defined(_MSC_VER)
+#include <intrin.h>
+#endif
+
+#ifdef KERNELS_X86
+
+bool cpuHasAVX2() {
+#ifdef _MSC_VER
+	int info[4];
+	__cpuid(info, 0);
+	if (info[0] < 7) return false;
+	__cpuid(info, 1);
+	bool osxsave = (info[2] & (1 << 27)) != 0;
+	bool avx = (info[2] & (1 << 28)) != 0;
+	bool fma = (info[2] & (1 << 12)) != 0;
+	if (!osxsave || !avx || !fma) return false;
+	if ((_xgetbv(0) & 6) != 6) return false;   // OS saves ymm state
+	__cpuidex(info, 7, 0);
+	return (info[1] & (1 << 5)) != 0;
+#else
+	__builtin_cpu_init();
+	return (__builtin_cpu_supports("avx2") && __builtin_cpu_supports("fma"));
+#endif
+}
+
+#else
+
+bool cpuHasAVX2() {
+	return false;
+}
+
+#endif // KERNELS_X86
+
+// KERNELS_X86 is only defined where the build already assumes SSE2 (see
+// KernelDispatch.h), so those builds never go below it
+//
+KernelLevel cpuKernelLevel() {
+	static const KernelLevel level = [] {
+#ifdef KERNELS_X86
+		return (cpuHasAVX2() ? KERNEL_AVX2 : KERNEL_SSE);
+#else
+		return KERNEL_SCALAR;
+#endif
+	}();
+	return level;
+}
@@ -0,0 +1,72 @@
+//
+//  KernelDispatch.h - runtime selection of the SIMD kernel families
+//
+//  PoseKernels, SkinKernels and BoxKernels each come in up to three versions:
+//  scalar (always compiled, the reference the others must match), SSE and AVX2
+//  (x86 builds that can assume SSE2, i.e. x86-64 or 32 bit builds with SSE2
+//  enabled; AVX2 functions are compiled for that target individually, so the
+//  rest of the build does not require it).  Each family lists its versions in a
+//  table indexed by KernelLevel, and bestKernel() / kernelByName() pick from it
+//  with the CPU check done once here.
+//
+#pragma once
+
+#include <cstddef>
+#include <cstring>
+
+// the SSE kernels are not checked at runtime, so a 32 bit build without SSE2
+// (e.g. plain -m32) gets the scalar kernels only
+//
+#if defined(__x86_64__) || defined(_M_X64) || defined(__SSE2__) || (defined(_M_IX86_FP) && _M_IX86_FP >= 2)
+#define KERNELS_X86 1
+#include <immintrin.h>
+#ifdef _MSC_VER
+#define KERNEL_TARGET_AVX2
+#else
+#define KERNEL_TARGET_AVX2 __attribute__((target("avx2,fma")))
+#endif
+#endif
+
+// a kernel table entry that only exists on x86
+//
+#ifdef KERNELS_X86
+#define KERNEL_X86(kernel) (kernel)
+#else
+#define KERNEL_X86(kernel) NULL
+#endif
+
+enum KernelLevel {
+	KERNEL_SCALAR,
+	KERNEL_SSE,
+	KERNEL_AVX2,
+	KERNEL_LEVELS
+};
+
+// true if the CPU and the OS support AVX2 + FMA (always false on other architectures)
+//
+bool cpuHasAVX2();
+
+// highest level this CPU runs (checked once)
+//
+KernelLevel cpuKernelLevel();
+
+// the highest level kernel in the table that the CPU supports
+//
+template <class Kernel>
+const Kernel &bestKernel(const Kernel *const (&kernels)[KERNEL_LEVELS]) {
+	for (int level = cpuKernelLevel(); level > KERNEL_SCALAR; level--) {
+		if (kernels[level]) return *kernels[level];
+	}
+	return *kernels[KERNEL_SCALAR];
+}
+
+// look up a kernel by name ("scalar", "sse", "avx2").
+// returns NULL if it is not compiled in or not supported by this CPU.
+//
+template <class Kernel>
+const Kernel *kernelByName(const Kernel *const (&kernels)[KERNEL_LEVELS], const char *name) {
+	for (int level = KERNEL_SCALAR; level <= cpuKernelLevel(); level++) {
+		if (kernels[level] && strcmp(kernels[level]->name, name) == 0) return kernels[level];
+	}
+	return NULL;
+}
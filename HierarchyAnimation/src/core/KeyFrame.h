@@ -0,0 +1,46 @@
+//
+//  KeyFrame.h - keyframe channels for animated scene objects
+//
+#pragma once
+
+#include "glm/glm.hpp"
+#include "glm/gtc/quaternion.hpp"
+
+class KeyFrame {
+public:
+	int frame = -1;     //  -1 => no key is set;
+	glm::vec3 position = glm::vec3(0, 0, 0);   // translate channel
+	glm::vec3 rotation = glm::vec3(0, 0, 0);   // rotate channel
+	glm::quat orientation = glm::quat(1, 0, 0, 0);   // rotate channel (quaternion joints)
+	glm::vec3 scale = glm::vec3(1, 1, 1);   // rotate channel
+};
+
+// parameter (0 to 1) of frame between two keys; same as ofMap(frame, frameStart, frameEnd, 0, 1)
+//
+inline float keyParam(int frame, int frameStart, int frameEnd) {
+	if (frameStart == frameEnd) return 0;
+	return ((float)(frame - frameStart) / (float)(frameEnd - frameStart));
+}
+
+// ease-in ease-out sigmoid normalized in x, y in (0 to 1)
+//
+inline float keyEase(float x) {
+	return (x * x / (x * x + (1 - x) * (1 - x)));
+}
+
+// channel value at frame between two keys, linear or ease-in ease-out
+//
+inline glm::vec3 keyInterp(int frame, int frameStart, int frameEnd, const glm::vec3 &start, const glm::vec3 &end, bool bEase) {
+	float s = keyParam(frame, frameStart, frameEnd);
+	if (bEase) s = keyEase(s);
+	return ((end - start) * s + start);
+}
+
+// Euler degrees (yaw, pitch, roll applied as Y * X * Z) to quaternion;
+// same order as SceneObject::getRotateMatrix()
+//
+inline glm::quat keyEulerToQuat(const glm::vec3 &r) {
+	return (glm::angleAxis(glm::radians(r.y), glm::vec3(0, 1, 0)) *
+		glm::angleAxis(glm::radians(r.x), glm::vec3(1, 0, 0)) *
+		glm::angleAxis(glm::radians(r.z), glm::vec3(0, 0, 1)));
+}
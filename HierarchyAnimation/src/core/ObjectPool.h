@@ -0,0 +1,115 @@
+//
+//  ObjectPool.h - block allocated pool of objects of one type with generational slots
+//
+//  Objects live in fixed size blocks, so objects of the same type are contiguous
+//  in memory and their addresses never change.  A slot is identified by its index
+//  and a generation; the generation is incremented whenever the object in the slot
+//  is destroyed, so a stale (index, generation) pair is detected by get() instead
+//  of pointing at a reused object.
+//
+//  clear() destroys every object in a single pass and keeps the blocks; the next
+//  objects are created from slot 0 again, in order.  No memory is returned until
+//  the pool itself is destroyed.
+//
+#pragma once
+
+#include <cstdint>
+#include <memory>
+#include <new>
+#include <utility>
+#include <vector>
+
+template <class T, int BLOCK_SIZE = 256>
+class ObjectPool {
+public:
+	ObjectPool() {}
+	ObjectPool(const ObjectPool &) = delete;
+	ObjectPool &operator=(const ObjectPool &) = delete;
+	~ObjectPool() { clear(); }
+
+	// construct a new object; returns its slot (see at()/generation())
+	//
+	template <class... Args>
+	uint32_t create(Args &&... args) {
+		uint32_t slot;
+		if (!freeSlots.empty()) {
+			slot = freeSlots.back();
+			freeSlots.pop_back();
+		}
+		else {
+			slot = used++;
+			if (slot / BLOCK_SIZE >= blocks.size()) {
+				blocks.emplace_back(new Storage[BLOCK_SIZE]);
+				generations.resize(blocks.size() * BLOCK_SIZE, 1);
+				bLive.resize(blocks.size() * BLOCK_SIZE, false);
+			}
+		}
+		new (address(slot)) T(std::forward<Args>(args)...);
+		bLive[slot] = true;
+		count++;
+		return slot;
+	}
+
+	// the object in slot, NULL if the slot is free
+	//
+	T *at(uint32_t slot) const {
+		return (slot < used && bLive[slot] ? address(slot) : NULL);
+	}
+
+	// the object in slot if it is still the one created with this generation
+	//
+	T *get(uint32_t slot, uint32_t generation) const {
+		return (slot < used && bLive[slot] && generations[slot] == generation ? address(slot) : NULL);
+	}
+
+	uint32_t generation(uint32_t slot) const { return generations[slot]; }
+
+	void destroy(uint32_t slot) {
+		if (!at(slot)) return;
+		release(slot);
+		freeSlots.push_back(slot);
+	}
+
+	void clear() {
+		for (uint32_t slot = 0; slot < used; slot++) {
+			if (bLive[slot]) release(slot);
+		}
+		freeSlots.clear();
+		used = 0;
+	}
+
+	int size() const { return count; }
+
+	// call fn(T *) for every live object, in memory order
+	//
+	template <class Fn>
+	void forEach(Fn fn) const {
+		for (uint32_t slot = 0; slot < used; slot++) {
+			if (bLive[slot]) fn(address(slot));
+		}
+	}
+
+private:
+	struct Storage {
+		alignas(T) unsigned char bytes[sizeof(T)];
+	};
+
+	T *address(uint32_t slot) const {
+		return reinterpret_cast<T *>(blocks[slot / BLOCK_SIZE][slot % BLOCK_SIZE].bytes);
+	}
+
+	void release(uint32_t slot) {
+		address(slot)->~T();
+		bLive[slot] = false;
+		generations[slot]++;
+		if (generations[slot] == 0) generations[slot] = 1;     // 0 is never a valid generation
+		count--;
+	}
+
+	std::vector<std::unique_ptr<Storage[]>> blocks;
+	std::vector<uint32_t> generations;
+	std::vector<bool> bLive;
+	std::vector<uint32_t> freeSlots;
+	uint32_t used = 0;        // slots below this have been handed out since the last clear()
+	int count = 0;
+};
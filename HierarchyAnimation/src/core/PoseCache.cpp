@@ -0,0 +1,261 @@
+//
+//  PoseCache.cpp - pre-baked poses for the playback range
+//
+
+#include "PoseCache.h"
+#include "PoseKernels.h"
+#include "JobSystem.h"
+#include "Profiler.h"
+#include "SceneGraph.h"
+#include <algorithm>
+
+void PoseCache::setup(const SkeletonPose &pose, int frameBegin, int frameEnd, bool bWorld) {
+	this->frameBegin = frameBegin;
+	this->frameEnd = std::max(frameEnd, frameBegin - 1);
+	this->bWorld = bWorld;
+	jointCount = pose.size();
+
+	animated.clear();
+	slotToAnimated.assign(jointCount, -1);
+	for (int i = 0; i < jointCount; i++) {
+		Joint *joint = dynamic_cast<Joint *>(pose.objects[i]);
+		if (joint && joint->keyFrames.size() > 1) {
+			slotToAnimated[i] = (int)animated.size();
+			animated.push_back(i);
+		}
+	}
+
+	size_t keyed = (size_t)frameCount() * animated.size();
+	translation.resize(keyed);
+	rotation.resize(keyed);
+	orientation.resize(keyed);
+	scale.resize(keyed);
+	world.resize(bWorld ? (size_t)frameCount() * jointCount : 0);
+	frameValid.assign(frameCount(), 0);
+	invalidCount = frameCount();
+}
+
+void PoseCache::invalidate() {
+	std::fill(frameValid.begin(), frameValid.end(), 0);
+	invalidCount = frameCount();
+}
+
+void PoseCache::invalidateRange(int from, int to) {
+	from = std::max(from, frameBegin);
+	to = std::min(to, frameEnd);
+	for (int f = from; f <= to; f++) {
+		unsigned char &valid = frameValid[f - frameBegin];
+		if (valid) {
+			valid = 0;
+			invalidCount++;
+		}
+	}
+}
+
+// sample the keys of joint at frame.  Same interpolation as keyInterp().
+// returns true if q still has to be nlerped towards qTo by u; bake() does
+// that for all frames of the joint at once with the batch kernel.
+//
+static bool sampleJoint(Joint *joint, int frame, bool bEase, bool bSlerp,
+	glm::vec3 &t, glm::vec3 &r, glm::quat &q, glm::vec3 &s, glm::quat &qTo, float &u) {
+
+	const std::vector<KeyFrame> &keys = joint->keyFrames;
+	int i = joint->findSegment(frame);
+	if (i < 0) {
+		const KeyFrame &kf = (frame < keys.front().frame ? keys.front() : keys.back());
+		t = kf.position;
+		r = kf.rotation;
+		q = kf.orientation;
+		s = kf.scale;
+		return false;
+	}
+
+	const KeyFrame &kf1 = keys[i];
+	const KeyFrame &kf2 = keys[i + 1];
+	u = keyParam(frame, kf1.frame, kf2.frame);
+	if (bEase) u = keyEase(u);
+
+	t = (kf2.position - kf1.position) * u + kf1.position;
+	s = (kf2.scale - kf1.scale) * u + kf1.scale;
+	if (joint->bQuatRotation) {
+		r = kf1.rotation;
+		if (!bSlerp) {
+			q = kf1.orientation;
+			qTo = kf2.orientation;
+			return true;
+		}
+		q = glm::slerp(kf1.orientation, kf2.orientation, u);
+	}
+	else {
+		r = (kf2.rotation - kf1.rotation) * u + kf1.rotation;
+		q = SceneObject::eulerToQuat(r);
+	}
+	return false;
+}
+
+// Baking runs in two parallel passes over the invalid frames:
+//
+//   1. key sampling, split by animated joint.  Each joint's frames are sampled
+//      in order by one thread, so its key cursor (findSegment()) stays cheap.
+//   2. world matrices, split by frame when several frames are invalid, or by
+//      joint range within the frame (SkeletonPose::computeWorld()) otherwise.
+//
+// Every output value is computed the same way in either case, so the cache
+// contents do not depend on the number of threads.
+//
+void PoseCache::bake(SkeletonPose &pose, bool bEase, bool bSlerp) {
+	if (isBaked()) return;
+	PROFILE_SCOPE("bake");
+
+	std::vector<int> frames;
+	for (int f = frameBegin; f <= frameEnd; f++) {
+		if (!frameValid[f - frameBegin]) frames.push_back(f);
+	}
+
+	JobSystem &jobs = jobSystem();
+	size_t count = animated.size();
+	const PoseKernel &kernel = poseKernel();
+	jobs.parallelFor((int)count, SAMPLE_CHUNK, [&](int begin, int end) {
+		std::vector<glm::quat> from, to, blended;
+		std::vector<float> u;
+		std::vector<size_t> at;
+		for (int k = begin; k < end; k++) {
+			Joint *joint = static_cast<Joint *>(pose.objects[animated[k]]);
+			from.clear();
+			to.clear();
+			u.clear();
+			at.clear();
+			for (int f : frames) {
+				size_t i = (size_t)(f - frameBegin) * count + k;
+				glm::quat qTo;
+				float t = 0;
+				if (sampleJoint(joint, f, bEase, bSlerp, translation[i], rotation[i], orientation[i], scale[i], qTo, t)) {
+					from.push_back(orientation[i]);
+					to.push_back(qTo);
+					u.push_back(t);
+					at.push_back(i);
+				}
+			}
+			if (at.empty()) continue;
+			blended.resize(at.size());
+			kernel.nlerp(from.data(), to.data(), u.data(), blended.data(), (int)at.size());
+			for (size_t m = 0; m < at.size(); m++) orientation[at[m]] = blended[m];
+		}
+	});
+
+	if (bWorld && jointCount > 0) {
+
+		// joints that are not animated keep their current channels
+		//
+		pose.pull();
+		bool bByFrame = (frames.size() > 1);
+		auto bakeWorld = [&](int begin, int end) {
+			std::vector<glm::vec3> t = pose.translation;
+			std::vector<glm::quat> q = pose.rotation;
+			std::vector<glm::vec3> s = pose.scale;
+			std::vector<glm::mat4> local(jointCount);
+			for (int j = begin; j < end; j++) {
+				int index = frames[j] - frameBegin;
+				size_t base = (size_t)index * count;
+				for (size_t k = 0; k < count; k++) {
+					int slot = animated[k];
+					t[slot] = translation[base + k];
+					q[slot] = orientation[base + k];
+					s[slot] = scale[base + k];
+				}
+				pose.computeWorld(t.data(), q.data(), s.data(), local.data(), &world[(size_t)index * jointCount], !bByFrame);
+			}
+		};
+		if (bByFrame) jobs.parallelFor((int)frames.size(), FRAME_CHUNK, bakeWorld);
+		else bakeWorld(0, (int)frames.size());
+	}
+
+	for (int f : frames) frameValid[f - frameBegin] = 1;
+	invalidCount = 0;
+}
+
+// Each edited subtree is a contiguous range of the pose.  Its local matrices
+// are rebuilt over the same LOCAL_CHUNK ranges as SkeletonPose::computeWorld()
+// uses, so every value comes out exactly as a full bake would produce it.
+//
+void PoseCache::updateChannels(SkeletonPose &pose, const std::vector<int> &slots) {
+	if (pose.size() != jointCount) return;
+
+	std::vector<int> roots(slots);
+	std::sort(roots.begin(), roots.end());
+	std::vector<std::pair<int, int>> ranges;
+	for (int slot : roots) {
+		if (slot < 0 || slot >= jointCount) continue;
+		if (!ranges.empty() && slot < ranges.back().second) continue;    // inside the previous subtree
+		ranges.push_back(std::make_pair(slot, pose.subtreeEnd(slot)));
+	}
+	for (auto &range : ranges) pose.pull(range.first, range.second);
+	if (!bWorld || ranges.empty()) return;
+
+	std::vector<int> frames;
+	for (int f = frameBegin; f <= frameEnd; f++) {
+		if (frameValid[f - frameBegin]) frames.push_back(f);
+	}
+	if (frames.empty()) return;
+	PROFILE_SCOPE("updateChannels");
+
+	const PoseKernel &kernel = poseKernel();
+	const int chunk = SkeletonPose::LOCAL_CHUNK;
+	size_t count = animated.size();
+	jobSystem().parallelFor((int)frames.size(), FRAME_CHUNK, [&](int begin, int end) {
+		std::vector<glm::vec3> t = pose.translation;
+		std::vector<glm::quat> q = pose.rotation;
+		std::vector<glm::vec3> s = pose.scale;
+		std::vector<glm::mat4> local(jointCount);
+		for (int j = begin; j < end; j++) {
+			int index = frames[j] - frameBegin;
+			size_t base = (size_t)index * count;
+			glm::mat4 *frameWorld = &world[(size_t)index * jointCount];
+			for (auto &range : ranges) {
+				for (int slot = range.first; slot < range.second; slot++) {
+					int k = slotToAnimated[slot];
+					if (k < 0) continue;
+					t[slot] = translation[base + k];
+					q[slot] = orientation[base + k];
+					s[slot] = scale[base + k];
+				}
+				for (int c = range.first / chunk * chunk; c < range.second; c += chunk) {
+					int n = std::min(c + chunk, jointCount) - c;
+					kernel.buildLocal(&t[c], &q[c], &s[c], &pose.pivot[c], &local[c], n);
+				}
+				kernel.concat(local.data(), pose.parent.data(), frameWorld, range.first, range.second);
+			}
+		}
+	});
+}
+
+bool PoseCache::apply(int frame, SkeletonPose &pose) const {
+	if (!isValid(frame) || pose.size() != jointCount) return false;
+
+	if (!bWorld) pose.pull();
+
+	int index = frame - frameBegin;
+	size_t base = (size_t)index * animated.size();
+	for (size_t k = 0; k < animated.size(); k++) {
+		int slot = animated[k];
+		SceneObject *obj = pose.objects[slot];
+		obj->position = translation[base + k];
+		if (obj->bQuatRotation) obj->orientation = orientation[base + k];
+		else obj->rotation = rotation[base + k];
+		obj->scale = scale[base + k];
+		obj->markDirty();
+
+		pose.translation[slot] = translation[base + k];
+		pose.rotation[slot] = orientation[base + k];
+		pose.scale[slot] = scale[base + k];
+	}
+
+	if (bWorld) {
+		std::copy(world.begin() + (size_t)index * jointCount, world.begin() + (size_t)(index + 1) * jointCount, pose.world.begin());
+	}
+	else {
+		pose.computeWorld();
+	}
+	pose.push();
+	return true;
+}
@@ -0,0 +1,97 @@
+//
+//  PoseCache.h - pre-baked poses for the playback range
+//
+//  Every frame in [frameBegin, frameEnd] is evaluated once from the keyframes and
+//  stored (local channels of the animated joints, and optionally the world matrices
+//  of the whole pose).  Playback and scrubbing then only copy a frame out of the
+//  cache.  Editing a key invalidates just the frames between its neighbouring keys;
+//  bake() re-evaluates only invalid frames.
+//
+//  Outside its keyed range a joint holds its first/last key.
+//
+#pragma once
+
+#include <vector>
+#include "glm/glm.hpp"
+#include "glm/gtc/quaternion.hpp"
+#include "SkeletonPose.h"
+
+class PoseCache {
+public:
+
+	// allocate the cache for pose over [frameBegin, frameEnd].  Every frame becomes
+	// invalid.  Must be called again when the pose is rebuilt or a joint starts or
+	// stops being animated (gets its second key / loses it).  bWorld also bakes
+	// the world matrices of every joint (see worldBytes()); without them apply()
+	// recomputes the pose from the channels.
+	//
+	void setup(const SkeletonPose &pose, int frameBegin, int frameEnd, bool bWorld = false);
+
+	// memory of the baked world matrices: one mat4 per joint, animated or not,
+	// and frame (10k joints over 500 frames are 320 MB)
+	//
+	static size_t worldBytes(int jointCount, int frameBegin, int frameEnd) {
+		return (frameEnd < frameBegin ? 0 : (size_t)jointCount * (size_t)(frameEnd - frameBegin + 1) * sizeof(glm::mat4));
+	}
+
+	// mark frames for re-baking
+	//
+	void invalidate();
+	void invalidateRange(int from, int to);
+
+	// the channels (not the keys) of pose slots were edited.  Key samples do not
+	// depend on them, so only the baked world matrices of the slots' subtrees are
+	// recomputed, in every valid frame.  The channels are pulled from the
+	// slots' objects.
+	//
+	void updateChannels(SkeletonPose &pose, const std::vector<int> &slots);
+
+	// evaluate every invalid frame, spread over all cores (see JobSystem.h).
+	// pose supplies the channels of joints that are not animated.
+	//
+	void bake(SkeletonPose &pose, bool bEase, bool bSlerp);
+
+	bool isBaked() const { return (invalidCount == 0); }
+	bool isValid(int frame) const {
+		return (frame >= frameBegin && frame <= frameEnd && frameValid[frame - frameBegin]);
+	}
+
+	// true if pose slot is driven by keyframes
+	//
+	bool isAnimated(int slot) const {
+		return (slot >= 0 && slot < (int)slotToAnimated.size() && slotToAnimated[slot] >= 0);
+	}
+
+	// copy a baked frame into the animated joints, the pose buffer and its world
+	// matrices (recomputed from the channels if world matrices are not baked).
+	// returns false (and changes nothing) if the frame is not valid.
+	//
+	bool apply(int frame, SkeletonPose &pose) const;
+
+	int frameBegin = 1;
+	int frameEnd = 0;
+	bool bWorld = false;     // world matrices are baked too, worldBytes() of memory
+
+private:
+	enum { SAMPLE_CHUNK = 16, FRAME_CHUNK = 4 };    // animated joints / frames per job
+
+	int frameCount() const { return frameEnd - frameBegin + 1; }
+
+	std::vector<int> animated;          // pose slot of each animated joint
+	std::vector<int> slotToAnimated;    // inverse of animated, -1 if not animated
+	int jointCount = 0;
+
+	// [frame * animated.size() + k]
+	//
+	std::vector<glm::vec3> translation;
+	std::vector<glm::vec3> rotation;    // Euler degrees, for Euler joints
+	std::vector<glm::quat> orientation;
+	std::vector<glm::vec3> scale;
+
+	// [frame * jointCount + slot], only if bWorld
+	//
+	std::vector<glm::mat4> world;
+
+	std::vector<unsigned char> frameValid;
+	int invalidCount = 0;
+};
@@ -0,0 +1,353 @@
+//
+//  PoseKernels.cpp - batch local-to-world matrix kernels for SkeletonPose
+//
+
+#include "PoseKernels.h"
+#include "KernelDispatch.h"
+#include <cstring>
+#include <cstddef>
+#include <cmath>
+
+// the SIMD kernels read quaternions as 4 packed floats (x, y, z, w)
+// and matrices as 16 packed floats (column major).
+//
+static_assert(sizeof(glm::quat) == 4 * sizeof(float), "unexpected glm::quat layout");
+static_assert(offsetof(glm::quat, x) == 0, "kernels expect x, y, z, w quaternion storage");
+static_assert(sizeof(glm::mat4) == 16 * sizeof(float), "unexpected glm::mat4 layout");
+static_assert(sizeof(glm::vec3) == 3 * sizeof(float), "unexpected glm::vec3 layout");
+
+
+//--------------------------------------------------------------
+// scalar reference
+//
+
+static void buildLocalScalar(const glm::vec3 *translation, const glm::quat *rotation,
+	const glm::vec3 *scale, const glm::vec3 *pivot, glm::mat4 *local, int count) {
+
+	for (int i = 0; i < count; i++) {
+		glm::mat3 r = glm::mat3_cast(rotation[i]);
+		glm::mat4 &m = local[i];
+		m[0] = glm::vec4(r[0] * scale[i].x, 0);
+		m[1] = glm::vec4(r[1] * scale[i].y, 0);
+		m[2] = glm::vec4(r[2] * scale[i].z, 0);
+		m[3] = glm::vec4(translation[i] + pivot[i] - r * pivot[i], 1);
+	}
+}
+
+static void concatScalar(const glm::mat4 *local, const int *parent, glm::mat4 *world, int begin, int end) {
+	for (int i = begin; i < end; i++) {
+		world[i] = (parent[i] < 0 ? local[i] : world[parent[i]] * local[i]);
+	}
+}
+
+// operations in the same order as the SIMD lanes, so all kernels agree bit
+// for bit (a bake gives the same quaternions however its frames are batched)
+//
+static void nlerpScalar(const glm::quat *a, const glm::quat *b, const float *t, glm::quat *out, int count) {
+	for (int i = 0; i < count; i++) {
+		const glm::quat &qa = a[i], &qb = b[i];
+		float dot = (qa.x * qb.x + qa.y * qb.y) + (qa.z * qb.z + qa.w * qb.w);
+		float ta = 1.0f - t[i];
+		float tb = (std::signbit(dot) ? -t[i] : t[i]);
+		glm::quat q;
+		q.x = qa.x * ta + qb.x * tb;
+		q.y = qa.y * ta + qb.y * tb;
+		q.z = qa.z * ta + qb.z * tb;
+		q.w = qa.w * ta + qb.w * tb;
+		float inv = 1.0f / std::sqrt((q.x * q.x + q.y * q.y) + (q.z * q.z + q.w * q.w));
+		out[i] = glm::quat(q.w * inv, q.x * inv, q.y * inv, q.z * inv);
+	}
+}
+
+static const PoseKernel scalarKernel = { "scalar", buildLocalScalar, concatScalar, nlerpScalar };
+
+
+#ifdef KERNELS_X86
+
+//--------------------------------------------------------------
+// SSE
+//
+
+// 12 matrix entries for 4 joints in SoA form: m[col][row] holds that entry for
+// each of the joints.  row 3 is implicit (0, 0, 0, 1).
+//
+struct LocalSoA4 {
+	__m128 m[4][3];
+};
+
+// build 4 local matrices from quaternion components (xs, ys, zs, ws) and
+// SoA translation/scale/pivot.
+//
+static inline void localFromChannels(__m128 qx, __m128 qy, __m128 qz, __m128 qw,
+	const __m128 t[3], const __m128 s[3], const __m128 p[3], LocalSoA4 &out) {
+
+	const __m128 one = _mm_set1_ps(1.0f);
+	const __m128 two = _mm_set1_ps(2.0f);
+
+	__m128 xx = _mm_mul_ps(qx, qx), yy = _mm_mul_ps(qy, qy), zz = _mm_mul_ps(qz, qz);
+	__m128 xy = _mm_mul_ps(qx, qy), xz = _mm_mul_ps(qx, qz), yz = _mm_mul_ps(qy, qz);
+	__m128 wx = _mm_mul_ps(qw, qx), wy = _mm_mul_ps(qw, qy), wz = _mm_mul_ps(qw, qz);
+
+	// rotation (same as glm::mat3_cast)
+	//
+	__m128 r[3][3];
+	r[0][0] = _mm_sub_ps(one, _mm_mul_ps(two, _mm_add_ps(yy, zz)));
+	r[0][1] = _mm_mul_ps(two, _mm_add_ps(xy, wz));
+	r[0][2] = _mm_mul_ps(two, _mm_sub_ps(xz, wy));
+	r[1][0] = _mm_mul_ps(two, _mm_sub_ps(xy, wz));
+	r[1][1] = _mm_sub_ps(one, _mm_mul_ps(two, _mm_add_ps(xx, zz)));
+	r[1][2] = _mm_mul_ps(two, _mm_add_ps(yz, wx));
+	r[2][0] = _mm_mul_ps(two, _mm_add_ps(xz, wy));
+	r[2][1] = _mm_mul_ps(two, _mm_sub_ps(yz, wx));
+	r[2][2] = _mm_sub_ps(one, _mm_mul_ps(two, _mm_add_ps(xx, yy)));
+
+	for (int c = 0; c < 3; c++) {
+		for (int k = 0; k < 3; k++) {
+			out.m[c][k] = _mm_mul_ps(r[c][k], s[c]);
+		}
+	}
+
+	// translation = t + pivot - R * pivot
+	//
+	for (int k = 0; k < 3; k++) {
+		__m128 rp = _mm_add_ps(_mm_add_ps(_mm_mul_ps(r[0][k], p[0]), _mm_mul_ps(r[1][k], p[1])), _mm_mul_ps(r[2][k], p[2]));
+		out.m[3][k] = _mm_sub_ps(_mm_add_ps(t[k], p[k]), rp);
+	}
+}
+
+// transpose the SoA result back into 4 column-major matrices
+//
+static inline void storeLocal4(const LocalSoA4 &in, glm::mat4 *local) {
+	float *dst[4] = { &local[0][0][0], &local[1][0][0], &local[2][0][0], &local[3][0][0] };
+	for (int c = 0; c < 4; c++) {
+		__m128 a = in.m[c][0], b = in.m[c][1], d = in.m[c][2];
+		__m128 w = (c == 3 ? _mm_set1_ps(1.0f) : _mm_setzero_ps());
+		_MM_TRANSPOSE4_PS(a, b, d, w);
+		_mm_storeu_ps(dst[0] + 4 * c, a);
+		_mm_storeu_ps(dst[1] + 4 * c, b);
+		_mm_storeu_ps(dst[2] + 4 * c, d);
+		_mm_storeu_ps(dst[3] + 4 * c, w);
+	}
+}
+
+static inline void loadVec3x4(const glm::vec3 *v, __m128 out[3]) {
+	out[0] = _mm_setr_ps(v[0].x, v[1].x, v[2].x, v[3].x);
+	out[1] = _mm_setr_ps(v[0].y, v[1].y, v[2].y, v[3].y);
+	out[2] = _mm_setr_ps(v[0].z, v[1].z, v[2].z, v[3].z);
+}
+
+static void buildLocalSSE(const glm::vec3 *translation, const glm::quat *rotation,
+	const glm::vec3 *scale, const glm::vec3 *pivot, glm::mat4 *local, int count) {
+
+	int i = 0;
+	for (; i + 4 <= count; i += 4) {
+		const float *q = &rotation[i].x;
+		__m128 qx = _mm_loadu_ps(q);
+		__m128 qy = _mm_loadu_ps(q + 4);
+		__m128 qz = _mm_loadu_ps(q + 8);
+		__m128 qw = _mm_loadu_ps(q + 12);
+		_MM_TRANSPOSE4_PS(qx, qy, qz, qw);
+
+		__m128 t[3], s[3], p[3];
+		loadVec3x4(translation + i, t);
+		loadVec3x4(scale + i, s);
+		loadVec3x4(pivot + i, p);
+
+		LocalSoA4 soa;
+		localFromChannels(qx, qy, qz, qw, t, s, p, soa);
+		storeLocal4(soa, local + i);
+	}
+	buildLocalScalar(translation + i, rotation + i, scale + i, pivot + i, local + i, count - i);
+}
+
+// R = A * B (column major, R must not alias A or B)
+//
+static inline void mulMat4SSE(const float *A, const float *B, float *R) {
+	__m128 a0 = _mm_loadu_ps(A);
+	__m128 a1 = _mm_loadu_ps(A + 4);
+	__m128 a2 = _mm_loadu_ps(A + 8);
+	__m128 a3 = _mm_loadu_ps(A + 12);
+	for (int j = 0; j < 4; j++) {
+		const float *b = B + 4 * j;
+		__m128 r = _mm_mul_ps(a0, _mm_set1_ps(b[0]));
+		r = _mm_add_ps(r, _mm_mul_ps(a1, _mm_set1_ps(b[1])));
+		r = _mm_add_ps(r, _mm_mul_ps(a2, _mm_set1_ps(b[2])));
+		r = _mm_add_ps(r, _mm_mul_ps(a3, _mm_set1_ps(b[3])));
+		_mm_storeu_ps(R + 4 * j, r);
+	}
+}
+
+static void concatSSE(const glm::mat4 *local, const int *parent, glm::mat4 *world, int begin, int end) {
+	for (int i = begin; i < end; i++) {
+		if (parent[i] < 0) world[i] = local[i];
+		else mulMat4SSE(&world[parent[i]][0][0], &local[i][0][0], &world[i][0][0]);
+	}
+}
+
+// 4 quaternions per iteration, transposed to SoA so the dot products,
+// hemisphere flips and normalization are all lane-wise.
+//
+static void nlerpSSE(const glm::quat *a, const glm::quat *b, const float *t, glm::quat *out, int count) {
+	const __m128 signMask = _mm_set1_ps(-0.0f);
+	const __m128 one = _mm_set1_ps(1.0f);
+
+	int i = 0;
+	for (; i + 4 <= count; i += 4) {
+		const float *pa = &a[i].x;
+		const float *pb = &b[i].x;
+		__m128 ax = _mm_loadu_ps(pa), ay = _mm_loadu_ps(pa + 4), az = _mm_loadu_ps(pa + 8), aw = _mm_loadu_ps(pa + 12);
+		__m128 bx = _mm_loadu_ps(pb), by = _mm_loadu_ps(pb + 4), bz = _mm_loadu_ps(pb + 8), bw = _mm_loadu_ps(pb + 12);
+		_MM_TRANSPOSE4_PS(ax, ay, az, aw);
+		_MM_TRANSPOSE4_PS(bx, by, bz, bw);
+
+		__m128 dot = _mm_add_ps(_mm_add_ps(_mm_mul_ps(ax, bx), _mm_mul_ps(ay, by)),
+			_mm_add_ps(_mm_mul_ps(az, bz), _mm_mul_ps(aw, bw)));
+
+		// weight for b takes the sign of the dot product (shorter arc)
+		//
+		__m128 tb = _mm_loadu_ps(t + i);
+		__m128 ta = _mm_sub_ps(one, tb);
+		tb = _mm_xor_ps(tb, _mm_and_ps(dot, signMask));
+
+		__m128 qx = _mm_add_ps(_mm_mul_ps(ax, ta), _mm_mul_ps(bx, tb));
+		__m128 qy = _mm_add_ps(_mm_mul_ps(ay, ta), _mm_mul_ps(by, tb));
+		__m128 qz = _mm_add_ps(_mm_mul_ps(az, ta), _mm_mul_ps(bz, tb));
+		__m128 qw = _mm_add_ps(_mm_mul_ps(aw, ta), _mm_mul_ps(bw, tb));
+
+		__m128 len2 = _mm_add_ps(_mm_add_ps(_mm_mul_ps(qx, qx), _mm_mul_ps(qy, qy)),
+			_mm_add_ps(_mm_mul_ps(qz, qz), _mm_mul_ps(qw, qw)));
+		__m128 inv = _mm_div_ps(one, _mm_sqrt_ps(len2));
+		qx = _mm_mul_ps(qx, inv);
+		qy = _mm_mul_ps(qy, inv);
+		qz = _mm_mul_ps(qz, inv);
+		qw = _mm_mul_ps(qw, inv);
+
+		_MM_TRANSPOSE4_PS(qx, qy, qz, qw);
+		float *po = &out[i].x;
+		_mm_storeu_ps(po, qx);
+		_mm_storeu_ps(po + 4, qy);
+		_mm_storeu_ps(po + 8, qz);
+		_mm_storeu_ps(po + 12, qw);
+	}
+	nlerpScalar(a + i, b + i, t + i, out + i, count - i);
+}
+
+static const PoseKernel sseKernel = { "sse", buildLocalSSE, concatSSE, nlerpSSE };
+
+
+//--------------------------------------------------------------
+// AVX2 + FMA
+//
+
+KERNEL_TARGET_AVX2
+static void buildLocalAVX2(const glm::vec3 *translation, const glm::quat *rotation,
+	const glm::vec3 *scale, const glm::vec3 *pivot, glm::mat4 *local, int count) {
+
+	const __m256i quatIndex = _mm256_setr_epi32(0, 4, 8, 12, 16, 20, 24, 28);
+	const __m256i vec3Index = _mm256_setr_epi32(0, 3, 6, 9, 12, 15, 18, 21);
+	const __m256 one = _mm256_set1_ps(1.0f);
+	const __m256 two = _mm256_set1_ps(2.0f);
+
+	int i = 0;
+	for (; i + 8 <= count; i += 8) {
+		const float *q = &rotation[i].x;
+		__m256 qx = _mm256_i32gather_ps(q, quatIndex, 4);
+		__m256 qy = _mm256_i32gather_ps(q + 1, quatIndex, 4);
+		__m256 qz = _mm256_i32gather_ps(q + 2, quatIndex, 4);
+		__m256 qw = _mm256_i32gather_ps(q + 3, quatIndex, 4);
+
+		__m256 t[3], s[3], p[3];
+		for (int k = 0; k < 3; k++) {
+			t[k] = _mm256_i32gather_ps(&translation[i].x + k, vec3Index, 4);
+			s[k] = _mm256_i32gather_ps(&scale[i].x + k, vec3Index, 4);
+			p[k] = _mm256_i32gather_ps(&pivot[i].x + k, vec3Index, 4);
+		}
+
+		__m256 xx = _mm256_mul_ps(qx, qx), yy = _mm256_mul_ps(qy, qy), zz = _mm256_mul_ps(qz, qz);
+		__m256 xy = _mm256_mul_ps(qx, qy), xz = _mm256_mul_ps(qx, qz), yz = _mm256_mul_ps(qy, qz);
+		__m256 wx = _mm256_mul_ps(qw, qx), wy = _mm256_mul_ps(qw, qy), wz = _mm256_mul_ps(qw, qz);
+
+		__m256 r[3][3];
+		r[0][0] = _mm256_fnmadd_ps(two, _mm256_add_ps(yy, zz), one);
+		r[0][1] = _mm256_mul_ps(two, _mm256_add_ps(xy, wz));
+		r[0][2] = _mm256_mul_ps(two, _mm256_sub_ps(xz, wy));
+		r[1][0] = _mm256_mul_ps(two, _mm256_sub_ps(xy, wz));
+		r[1][1] = _mm256_fnmadd_ps(two, _mm256_add_ps(xx, zz), one);
+		r[1][2] = _mm256_mul_ps(two, _mm256_add_ps(yz, wx));
+		r[2][0] = _mm256_mul_ps(two, _mm256_add_ps(xz, wy));
+		r[2][1] = _mm256_mul_ps(two, _mm256_sub_ps(yz, wx));
+		r[2][2] = _mm256_fnmadd_ps(two, _mm256_add_ps(xx, yy), one);
+
+		__m256 m[4][3];
+		for (int c = 0; c < 3; c++) {
+			for (int k = 0; k < 3; k++) {
+				m[c][k] = _mm256_mul_ps(r[c][k], s[c]);
+			}
+		}
+		for (int k = 0; k < 3; k++) {
+			__m256 rp = _mm256_fmadd_ps(r[2][k], p[2], _mm256_fmadd_ps(r[1][k], p[1], _mm256_mul_ps(r[0][k], p[0])));
+			m[3][k] = _mm256_sub_ps(_mm256_add_ps(t[k], p[k]), rp);
+		}
+
+		// each 128-bit half is a batch of 4; reuse the SSE transpose/store
+		//
+		LocalSoA4 lo, hi;
+		for (int c = 0; c < 4; c++) {
+			for (int k = 0; k < 3; k++) {
+				lo.m[c][k] = _mm256_castps256_ps128(m[c][k]);
+				hi.m[c][k] = _mm256_extractf128_ps(m[c][k], 1);
+			}
+		}
+		storeLocal4(lo, local + i);
+		storeLocal4(hi, local + i + 4);
+	}
+	buildLocalSSE(translation + i, rotation + i, scale + i, pivot + i, local + i, count - i);
+}
+
+// two result columns per iteration: each 128-bit lane holds one column
+//
+KERNEL_TARGET_AVX2
+static void concatAVX2(const glm::mat4 *local, const int *parent, glm::mat4 *world, int begin, int end) {
+	for (int i = begin; i < end; i++) {
+		if (parent[i] < 0) {
+			world[i] = local[i];
+			continue;
+		}
+		const float *A = &world[parent[i]][0][0];
+		const float *B = &local[i][0][0];
+		float *R = &world[i][0][0];
+
+		__m256 a0 = _mm256_broadcast_ps((const __m128 *)A);
+		__m256 a1 = _mm256_broadcast_ps((const __m128 *)(A + 4));
+		__m256 a2 = _mm256_broadcast_ps((const __m128 *)(A + 8));
+		__m256 a3 = _mm256_broadcast_ps((const __m128 *)(A + 12));
+		for (int j = 0; j < 16; j += 8) {
+			__m256 b = _mm256_loadu_ps(B + j);
+			__m256 r = _mm256_mul_ps(a0, _mm256_permute_ps(b, 0x00));
+			r = _mm256_fmadd_ps(a1, _mm256_permute_ps(b, 0x55), r);
+			r = _mm256_fmadd_ps(a2, _mm256_permute_ps(b, 0xAA), r);
+			r = _mm256_fmadd_ps(a3, _mm256_permute_ps(b, 0xFF), r);
+			_mm256_storeu_ps(R + j, r);
+		}
+	}
+}
+
+static const PoseKernel avx2Kernel = { "avx2", buildLocalAVX2, concatAVX2, nlerpSSE };
+
+#endif // KERNELS_X86
+
+
+//--------------------------------------------------------------
+//
+static const PoseKernel *const kernels[KERNEL_LEVELS] = {
+	&scalarKernel, KERNEL_X86(&sseKernel), KERNEL_X86(&avx2Kernel)
+};
+
+const PoseKernel *poseKernelByName(const char *name) {
+	return kernelByName(kernels, name);
+}
+
+const PoseKernel &poseKernel() {
+	static const PoseKernel &best = bestKernel(kernels);
+	return best;
+}
@@ -0,0 +1,46 @@
+//
+//  PoseKernels.h - batch local-to-world matrix kernels for SkeletonPose
+//
+//  The work is split in two stages:
+//
+//    buildLocal() - builds trans * post * rotate * pre * scale for many joints at
+//                   once.  Joints are independent here, so the SIMD versions
+//                   evaluate 4 (SSE) or 8 (AVX2) joints per iteration.
+//
+//    concat()     - world[i] = world[parent[i]] * local[i] in parent-first order,
+//                   one SIMD matrix product per joint.
+//
+//  nlerp() is the matching batch kernel for the quaternion rotation channel;
+//  PoseCache::bake() runs it once per joint over all the frames it bakes.
+//
+//  Scalar, SSE and AVX2 versions; see KernelDispatch.h for how one is picked.
+//
+#pragma once
+
+#include "glm/glm.hpp"
+#include "glm/gtc/quaternion.hpp"
+
+struct PoseKernel {
+	const char *name;
+
+	void (*buildLocal)(const glm::vec3 *translation, const glm::quat *rotation,
+		const glm::vec3 *scale, const glm::vec3 *pivot, glm::mat4 *local, int count);
+
+	// joints [begin, end) are processed; parents must already be done
+	// (parent[i] < i, or parent[i] == -1 for a root).
+	//
+	void (*concat)(const glm::mat4 *local, const int *parent, glm::mat4 *world, int begin, int end);
+
+	// out[i] = normalize(a[i] * (1 - t[i]) + b[i] * t[i]), taking the shorter arc
+	//
+	void (*nlerp)(const glm::quat *a, const glm::quat *b, const float *t, glm::quat *out, int count);
+};
+
+// best kernel for this CPU (selected once, on first use)
+//
+const PoseKernel &poseKernel();
+
+// look up a kernel by name ("scalar", "sse", "avx2").
+// returns NULL if it is not compiled in or not supported by this CPU.
+//
+const PoseKernel *poseKernelByName(const char *name);
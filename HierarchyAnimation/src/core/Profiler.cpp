@@ -0,0 +1,135 @@
+//
+//  Profiler.cpp - scoped stage timers, per-frame statistics and Chrome trace export
+//
+
+#include "Profiler.h"
+#include <algorithm>
+#include <atomic>
+#include <fstream>
+#include <iomanip>
+
+// small stable id per thread for the trace viewer
+//
+static int threadId() {
+	static std::atomic<int> next(1);
+	static thread_local int id = next++;
+	return id;
+}
+
+Profiler::Profiler() : start(std::chrono::steady_clock::now()) {}
+
+Profiler::Stage &Profiler::stage(const char *name) {
+	for (auto &s : stages) {
+		if (s.name == name) return s;
+	}
+	stages.push_back(Stage());
+	stages.back().name = name;
+	return stages.back();
+}
+
+void Profiler::record(const char *name, int64_t begin, int64_t end) {
+	if (!bEnabled) return;
+	int thread = threadId();
+	std::lock_guard<std::mutex> lock(mutex);
+	events.push_back({ name, begin, end, thread });
+	stage(name).frameTotal += end - begin;
+}
+
+void Profiler::endFrame() {
+	int64_t t = now();
+	std::lock_guard<std::mutex> lock(mutex);
+
+	frames.push_back((t - frameBegin) * 1e-6f);
+	if ((int)frames.size() > window) frames.pop_front();
+	frameBegin = t;
+
+	for (auto &s : stages) {
+		s.history.push_back(s.frameTotal * 1e-6f);
+		if ((int)s.history.size() > window) s.history.pop_front();
+		s.frameTotal = 0;
+	}
+
+	int64_t oldest = t - (int64_t)(keepSeconds * 1e9);
+	while (!events.empty() && events.front().end < oldest) events.pop_front();
+	while (!counterSamples.empty() && counterSamples.front().time < oldest) counterSamples.pop_front();
+}
+
+void Profiler::setCounter(const char *name, int64_t value) {
+	if (!bEnabled) return;
+	int64_t t = now();
+	std::lock_guard<std::mutex> lock(mutex);
+	counterSamples.push_back({ name, t, value });
+	for (auto &c : counterValues) {
+		if (c.name == name) {
+			c.value = value;
+			return;
+		}
+	}
+	counterValues.push_back({ name, value });
+}
+
+std::vector<Profiler::CounterValue> Profiler::counters() const {
+	std::lock_guard<std::mutex> lock(mutex);
+	return counterValues;
+}
+
+std::vector<Profiler::StageStats> Profiler::stageStats() const {
+	std::lock_guard<std::mutex> lock(mutex);
+	std::vector<StageStats> stats;
+	for (const auto &s : stages) {
+		if (s.history.empty()) continue;
+		std::vector<float> sorted(s.history.begin(), s.history.end());
+		std::sort(sorted.begin(), sorted.end());
+		double sum = 0;
+		for (float ms : sorted) sum += ms;
+		size_t p99 = std::min(sorted.size() - 1, (size_t)(0.99 * sorted.size()));
+		stats.push_back({ s.name, sum / sorted.size(), sorted[p99], s.history.back() });
+	}
+	return stats;
+}
+
+std::vector<float> Profiler::frameTimes() const {
+	std::lock_guard<std::mutex> lock(mutex);
+	return std::vector<float>(frames.begin(), frames.end());
+}
+
+// complete ("X") and counter ("C") events, timestamps in microseconds
+//
+bool Profiler::writeChromeTrace(const std::string &path, double seconds) const {
+	std::vector<Event> copy;
+	std::vector<CounterSample> samples;
+	{
+		std::lock_guard<std::mutex> lock(mutex);
+		int64_t oldest = now() - (int64_t)(seconds * 1e9);
+		for (const auto &e : events) {
+			if (e.end >= oldest) copy.push_back(e);
+		}
+		for (const auto &c : counterSamples) {
+			if (c.time >= oldest) samples.push_back(c);
+		}
+	}
+
+	std::ofstream file(path);
+	if (!file.is_open()) return false;
+	file << std::fixed << std::setprecision(3);
+	file << "{\"displayTimeUnit\": \"ms\", \"traceEvents\": [\n";
+	for (size_t i = 0; i < copy.size(); i++) {
+		const Event &e = copy[i];
+		file << "{\"name\": \"" << e.name << "\", \"ph\": \"X\", \"pid\": 1, \"tid\": " << e.thread
+			<< ", \"ts\": " << e.begin / 1000.0 << ", \"dur\": " << (e.end - e.begin) / 1000.0 << "}"
+			<< (i + 1 < copy.size() || !samples.empty() ? ",\n" : "\n");
+	}
+	for (size_t i = 0; i < samples.size(); i++) {
+		const CounterSample &c = samples[i];
+		file << "{\"name\": \"" << c.name << "\", \"ph\": \"C\", \"pid\": 1, \"ts\": " << c.time / 1000.0
+			<< ", \"args\": {\"" << c.name << "\": " << c.value << "}}"
+			<< (i + 1 < samples.size() ? ",\n" : "\n");
+	}
+	file << "]}\n";
+	return file.good();
+}
+
+Profiler &profiler() {
+	static Profiler instance;
+	return instance;
+}
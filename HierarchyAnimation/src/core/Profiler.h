@@ -0,0 +1,119 @@
+//
+//  Profiler.h - scoped stage timers, per-frame statistics and Chrome trace export
+//
+//  PROFILE_SCOPE("name") times the rest of the enclosing block.  Events from any
+//  thread are kept for the last keepSeconds; endFrame() (once per app frame) sums
+//  the events of each stage over the frame and keeps a rolling window of those
+//  sums for the overlay.  writeChromeTrace() dumps the kept events in the Chrome
+//  trace event format (chrome://tracing, Perfetto).
+//
+//  setCounter() records a value per frame (e.g. the number of culled objects);
+//  it is shown next to the stages and as a counter track in the trace.
+//
+//  Stage names must be string literals (only the pointer is stored).
+//
+#pragma once
+
+#include <cstdint>
+#include <string>
+#include <vector>
+#include <deque>
+#include <mutex>
+#include <atomic>
+#include <chrono>
+
+class Profiler {
+public:
+	Profiler();
+
+	// nanoseconds since the profiler was created
+	//
+	int64_t now() const {
+		return std::chrono::duration_cast<std::chrono::nanoseconds>(std::chrono::steady_clock::now() - start).count();
+	}
+
+	void record(const char *name, int64_t begin, int64_t end);
+
+	// close the current frame (call once per frame, e.g. at the start of update())
+	//
+	void endFrame();
+
+	struct StageStats {
+		const char *name;
+		double averageMs;     // over the window
+		double p99Ms;
+		double lastMs;
+	};
+
+	// per stage statistics over the last window frames, in first-seen order
+	//
+	std::vector<StageStats> stageStats() const;
+
+	// frame times (ms) of the last window frames, oldest first
+	//
+	std::vector<float> frameTimes() const;
+
+	void setCounter(const char *name, int64_t value);
+
+	struct CounterValue {
+		const char *name;
+		int64_t value;       // last value set
+	};
+	std::vector<CounterValue> counters() const;
+
+	// write the events of the last seconds; returns false if the file can't be written
+	//
+	bool writeChromeTrace(const std::string &path, double seconds) const;
+
+	std::atomic<bool> bEnabled{ true };
+	double keepSeconds = 10.0;
+	int window = 120;         // frames in the rolling statistics
+
+private:
+	struct Event {
+		const char *name;
+		int64_t begin, end;
+		int thread;
+	};
+	struct CounterSample {
+		const char *name;
+		int64_t time;
+		int64_t value;
+	};
+	struct Stage {
+		const char *name;
+		int64_t frameTotal = 0;          // ns in the current frame
+		std::deque<float> history;       // ms per frame
+	};
+
+	Stage &stage(const char *name);
+
+	std::chrono::steady_clock::time_point start;
+	mutable std::mutex mutex;
+	std::deque<Event> events;
+	std::vector<Stage> stages;
+	std::deque<CounterSample> counterSamples;
+	std::vector<CounterValue> counterValues;
+	std::deque<float> frames;     // ms
+	int64_t frameBegin = 0;
+};
+
+// the app wide profiler
+//
+Profiler &profiler();
+
+// times its lifetime as one event of stage name
+//
+class ProfileScope {
+public:
+	explicit ProfileScope(const char *name) : name(name), begin(profiler().now()) {}
+	~ProfileScope() { profiler().record(name, begin, profiler().now()); }
+
+private:
+	const char *name;
+	int64_t begin;
+};
+
+#define PROFILE_CONCAT2(a, b) a##b
+#define PROFILE_CONCAT(a, b) PROFILE_CONCAT2(a, b)
+#define PROFILE_SCOPE(name) ProfileScope PROFILE_CONCAT(profileScope, __LINE__)(name)
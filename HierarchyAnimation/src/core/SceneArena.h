@@ -0,0 +1,175 @@
+//
+//  SceneArena.h - owner of the scene objects
+//
+//  Every object type gets its own ObjectPool, so e.g. all joints of a loaded
+//  skeleton sit in consecutive blocks.  create() returns a plain pointer for the
+//  hierarchy and the renderer; code that keeps a reference across edits (the
+//  selection) stores the object's SceneHandle and resolves it with get().
+//
+//  clear() drops the whole scene at once: the objects are destroyed in place,
+//  the pool blocks are kept for the next scene, and every handle handed out so
+//  far resolves to NULL afterwards.
+//
+//  Besides all live objects, the arena keeps a dense list per object type and
+//  one of every Joint (of any subclass), so per-frame code iterates just the
+//  objects it needs and asJoint() tells joints apart by the handle, without a
+//  dynamic_cast.  The lists are updated by create(), destroy() and clear().
+//
+//  The arena does not know about the hierarchy: unlink an object from its parent
+//  and children before destroy() (parent and childList are not owning).
+//
+#pragma once
+
+#include <atomic>
+#include <cstdint>
+#include <memory>
+#include <type_traits>
+#include <vector>
+#include <algorithm>
+#include "SceneGraph.h"
+#include "ObjectPool.h"
+
+class SceneArena {
+public:
+	SceneArena() {}
+	SceneArena(const SceneArena &) = delete;
+	SceneArena &operator=(const SceneArena &) = delete;
+	~SceneArena() { clear(); }
+
+	template <class T, class... Args>
+	T *create(Args &&... args) {
+		static_assert(std::is_base_of<SceneObject, T>::value, "SceneArena only holds SceneObjects");
+		uint32_t id = typeId<T>();
+		if (id >= pools.size()) pools.resize(id + 1);
+		if (!pools[id]) pools[id].reset(new Pool<T>());
+		ObjectPool<T> &pool = static_cast<Pool<T> *>(pools[id].get())->objects;
+
+		uint32_t slot = pool.create(std::forward<Args>(args)...);
+		T *obj = pool.at(slot);
+		obj->handle.index = (id << SLOT_BITS) | slot;
+		obj->handle.generation = pool.generation(slot);
+		static_cast<Pool<T> *>(pools[id].get())->members.push_back(obj);
+		live.push_back(obj);
+		Joint *joint = toJoint(obj, std::is_base_of<Joint, T>());
+		if (joint) {
+			if (id >= jointPools.size()) jointPools.resize(id + 1, 0);
+			jointPools[id] = 1;
+			jointList.push_back(joint);
+		}
+		return obj;
+	}
+
+	// the object of handle h, NULL if it has been destroyed (or h is null)
+	//
+	SceneObject *get(const SceneHandle &h) const {
+		if (h.isNull()) return NULL;
+		uint32_t id = h.index >> SLOT_BITS;
+		if (id >= pools.size() || !pools[id]) return NULL;
+		return pools[id]->get(h.index & SLOT_MASK, h.generation);
+	}
+
+	// the object of handle h if it is exactly a T (not a subclass), NULL otherwise.
+	// the type is read from the handle, so this replaces a dynamic_cast
+	//
+	template <class T>
+	T *getAs(const SceneHandle &h) const {
+		if ((h.index >> SLOT_BITS) != typeId<T>()) return NULL;
+		return static_cast<T *>(get(h));
+	}
+
+	// obj as a Joint if it is one (any subclass), NULL otherwise
+	//
+	Joint *asJoint(SceneObject *obj) const {
+		if (!obj) return NULL;
+		uint32_t id = obj->handle.index >> SLOT_BITS;
+		return (id < jointPools.size() && jointPools[id] ? static_cast<Joint *>(obj) : NULL);
+	}
+
+	bool owns(const SceneObject *obj) const { return obj && get(obj->handle) == obj; }
+
+	void destroy(SceneObject *obj) {
+		if (!owns(obj)) return;
+		live.erase(std::remove(live.begin(), live.end(), obj), live.end());
+		Joint *joint = asJoint(obj);
+		if (joint) jointList.erase(std::remove(jointList.begin(), jointList.end(), joint), jointList.end());
+		pools[obj->handle.index >> SLOT_BITS]->destroy(obj->handle.index & SLOT_MASK);
+	}
+
+	void clear() {
+		live.clear();
+		jointList.clear();
+		for (auto &pool : pools) {
+			if (pool) pool->clear();
+		}
+	}
+
+	// live objects in creation order
+	//
+	const std::vector<SceneObject *> &objects() const { return live; }
+	int size() const { return (int)live.size(); }
+
+	// live objects of exactly type T / every live joint, in creation order
+	//
+	template <class T>
+	const std::vector<T *> &all() const {
+		static const std::vector<T *> none;
+		uint32_t id = typeId<T>();
+		if (id >= pools.size() || !pools[id]) return none;
+		return static_cast<const Pool<T> *>(pools[id].get())->members;
+	}
+	const std::vector<Joint *> &joints() const { return jointList; }
+	bool empty() const { return live.empty(); }
+
+	// a handle's index is the pool of the object's type in the top bits and
+	// the slot in that pool below
+	//
+	static const uint32_t SLOT_BITS = 24;
+	static const uint32_t SLOT_MASK = (1u << SLOT_BITS) - 1;
+
+private:
+
+	struct PoolBase {
+		virtual ~PoolBase() {}
+		virtual SceneObject *get(uint32_t slot, uint32_t generation) const = 0;
+		virtual void destroy(uint32_t slot) = 0;
+		virtual void clear() = 0;
+	};
+
+	template <class T>
+	struct Pool : PoolBase {
+		SceneObject *get(uint32_t slot, uint32_t generation) const { return objects.get(slot, generation); }
+		void destroy(uint32_t slot) {
+			T *obj = objects.at(slot);
+			members.erase(std::remove(members.begin(), members.end(), obj), members.end());
+			objects.destroy(slot);
+		}
+		void clear() {
+			members.clear();
+			objects.clear();
+		}
+		ObjectPool<T> objects;
+		std::vector<T *> members;     // live objects, creation order
+	};
+
+	// one small id per object type (the same in every arena)
+	//
+	static uint32_t nextTypeId() {
+		static std::atomic<uint32_t> next(0);
+		return next++;
+	}
+	template <class T>
+	static uint32_t typeId() {
+		static const uint32_t id = nextTypeId();
+		return id;
+	}
+
+	template <class T>
+	static Joint *toJoint(T *obj, std::true_type) { return obj; }
+	template <class T>
+	static Joint *toJoint(T *obj, std::false_type) { return NULL; }
+
+	std::vector<std::unique_ptr<PoolBase>> pools;     // indexed by typeId()
+	std::vector<unsigned char> jointPools;           // 1 => pool of a Joint type
+	std::vector<SceneObject *> live;
+	std::vector<Joint *> jointList;
+};
@@ -0,0 +1,174 @@
+//
+//  SceneBVH.cpp - bounding volume hierarchy over the world space bounds of scene objects
+//
+
+#include "SceneBVH.h"
+#include "SceneGraph.h"
+#include "BoundsRefit.h"
+#include <algorithm>
+#include <limits>
+
+static const int LEAF_SIZE = BOX_PACKET;    // a leaf is one packet test
+static const int STACK_SIZE = 64;
+
+void SceneBVH::clear() {
+	nodes.clear();
+	items.clear();
+	itemBoxes.clear();
+	nodeDirty.clear();
+}
+
+// world space AABB of the object's local bounds
+//
+void SceneBVH::computeBounds(Item &item) {
+	glm::mat4 M = item.obj->getMatrix();
+	item.version = item.obj->worldVersion;
+
+	glm::vec3 localMin, localMax;
+	item.obj->getLocalBounds(localMin, localMax);
+	transformBounds(M, localMin, localMax, item.boundsMin, item.boundsMax);
+}
+
+void SceneBVH::fitNode(Node &node) {
+	if (node.count > 0) {
+		node.boundsMin = items[node.first].boundsMin;
+		node.boundsMax = items[node.first].boundsMax;
+		for (int i = node.first + 1; i < node.first + node.count; i++) {
+			node.boundsMin = glm::min(node.boundsMin, items[i].boundsMin);
+			node.boundsMax = glm::max(node.boundsMax, items[i].boundsMax);
+		}
+	}
+	else {
+		const Node &a = nodes[node.first];
+		const Node &b = nodes[node.first + 1];
+		node.boundsMin = glm::min(a.boundsMin, b.boundsMin);
+		node.boundsMax = glm::max(a.boundsMax, b.boundsMax);
+	}
+}
+
+// split items [begin, end) at the median of the longest axis of their centers
+//
+void SceneBVH::buildNode(int index, int begin, int end) {
+	if (end - begin <= LEAF_SIZE) {
+		nodes[index].first = begin;
+		nodes[index].count = end - begin;
+		for (int i = begin; i < end; i++) items[i].leaf = index;
+		fitNode(nodes[index]);
+		return;
+	}
+
+	glm::vec3 centerMin = items[begin].boundsMin + items[begin].boundsMax;
+	glm::vec3 centerMax = centerMin;
+	for (int i = begin + 1; i < end; i++) {
+		glm::vec3 c = items[i].boundsMin + items[i].boundsMax;
+		centerMin = glm::min(centerMin, c);
+		centerMax = glm::max(centerMax, c);
+	}
+	glm::vec3 size = centerMax - centerMin;
+	int axis = (size.x > size.y ? (size.x > size.z ? 0 : 2) : (size.y > size.z ? 1 : 2));
+
+	int mid = (begin + end) / 2;
+	std::nth_element(items.begin() + begin, items.begin() + mid, items.begin() + end,
+		[axis](const Item &a, const Item &b) {
+			return (a.boundsMin[axis] + a.boundsMax[axis] < b.boundsMin[axis] + b.boundsMax[axis]);
+		});
+
+	int first = (int)nodes.size();
+	nodes.push_back(Node{ glm::vec3(0), glm::vec3(0), 0, 0, index });
+	nodes.push_back(Node{ glm::vec3(0), glm::vec3(0), 0, 0, index });
+	nodes[index].first = first;
+	nodes[index].count = 0;
+	buildNode(first, begin, mid);
+	buildNode(first + 1, mid, end);
+	fitNode(nodes[index]);
+}
+
+void SceneBVH::build(const std::vector<SceneObject *> &scene) {
+	clear();
+
+	glm::vec3 boundsMin, boundsMax;
+	for (SceneObject *obj : scene) {
+		if (!obj->isSelectable || !obj->getLocalBounds(boundsMin, boundsMax)) continue;
+		Item item;
+		item.obj = obj;
+		computeBounds(item);
+		items.push_back(item);
+	}
+	if (items.empty()) return;
+
+	nodes.reserve(2 * items.size());
+	nodes.push_back(Node{ glm::vec3(0), glm::vec3(0), 0, 0, -1 });
+	buildNode(0, 0, (int)items.size());
+	nodeDirty.assign(nodes.size(), 0);
+
+	itemBoxes.resize((int)items.size());
+	for (int i = 0; i < (int)items.size(); i++) itemBoxes.set(i, items[i].boundsMin, items[i].boundsMax);
+}
+
+void SceneBVH::refit() {
+	refitBounds(items, nodes, nodeDirty,
+		[&](int i) {
+			Item &item = items[i];
+			computeBounds(item);
+			itemBoxes.set(i, item.boundsMin, item.boundsMax);
+			return item.leaf;
+		},
+		[&](int n) { fitNode(nodes[n]); });
+}
+
+SceneObject *SceneBVH::intersect(const Ray &ray, float &t) const {
+	if (nodes.empty()) return NULL;
+
+	const BoxKernel &kernel = boxKernel();
+	glm::vec3 invDir = rayInverse(ray.d);
+	float nearest = std::numeric_limits<float>::infinity();
+	SceneObject *hit = NULL;
+
+	struct Entry { int node; float t; };
+	Entry stack[STACK_SIZE];
+	int top = 0;
+
+	float tNear = 0, tFar = nearest;
+	if (!intersectRayBox(ray.p, invDir, nodes[0].boundsMin, nodes[0].boundsMax, tNear, tFar)) return NULL;
+	stack[top++] = { 0, tNear };
+
+	while (top > 0) {
+		Entry entry = stack[--top];
+		if (entry.t > nearest) continue;
+		const Node &node = nodes[entry.node];
+
+		if (node.count > 0) {
+			float tEntry[BOX_PACKET];
+			unsigned mask = kernel.intersect(itemBoxes, node.first, ray.p, invDir, 0, nearest, tEntry);
+			mask &= (1u << node.count) - 1;
+			for (int i = 0; mask; i++, mask >>= 1) {
+				if (!(mask & 1) || tEntry[i] > nearest) continue;
+				float tHit;
+				SceneObject *obj = items[node.first + i].obj;
+				if (obj->isSelectable && obj->intersectRay(ray, tHit) && tHit < nearest) {
+					nearest = tHit;
+					hit = obj;
+				}
+			}
+			continue;
+		}
+
+		// visit the nearer child first, so farther subtrees can be skipped
+		//
+		float t0 = 0, t0Far = nearest;
+		float t1 = 0, t1Far = nearest;
+		bool bHit0 = intersectRayBox(ray.p, invDir, nodes[node.first].boundsMin, nodes[node.first].boundsMax, t0, t0Far);
+		bool bHit1 = intersectRayBox(ray.p, invDir, nodes[node.first + 1].boundsMin, nodes[node.first + 1].boundsMax, t1, t1Far);
+		if (bHit0 && bHit1 && t1 < t0) {
+			stack[top++] = { node.first, t0 };
+			stack[top++] = { node.first + 1, t1 };
+		}
+		else {
+			if (bHit1) stack[top++] = { node.first + 1, t1 };
+			if (bHit0) stack[top++] = { node.first, t0 };
+		}
+	}
+
+	if (hit) t = nearest;
+	return hit;
+}
@@ -0,0 +1,64 @@
+//
+//  SceneBVH.h - bounding volume hierarchy over the world space bounds of scene objects
+//
+//  Used for mouse picking.  Each selectable object with local bounds (see
+//  SceneObject::getLocalBounds()) gets a world space AABB; the tree is built once
+//  after the scene changes and refit as objects move:  refit() only recomputes
+//  the boxes of objects whose world matrix was rebuilt since the last refit
+//  (SceneObject::worldVersion) and the nodes above them.
+//
+//  The item boxes are also kept structure of arrays (see BoxKernels.h), so a leaf
+//  is tested against the ray with one packet test; only the objects whose box is
+//  hit get the exact (object space) test.
+//
+#pragma once
+
+#include <vector>
+#include "glm/glm.hpp"
+#include "BoxKernels.h"
+
+class SceneObject;
+class Ray;
+
+class SceneBVH {
+public:
+
+	// rebuild the tree.  must be called after objects are added or deleted.
+	//
+	void build(const std::vector<SceneObject *> &scene);
+
+	// update the boxes of objects that moved since build()/refit()
+	//
+	void refit();
+
+	// nearest object hit by ray (ray.d normalized), or NULL.
+	// t is set to the distance along the ray.
+	//
+	SceneObject *intersect(const Ray &ray, float &t) const;
+
+	void clear();
+	int size() const { return (int)items.size(); }
+
+private:
+	struct Node {
+		glm::vec3 boundsMin, boundsMax;
+		int first;      // leaf: first item;  inner: first child (second child is first + 1)
+		int count;      // leaf: number of items;  inner: 0
+		int parent;
+	};
+	struct Item {
+		SceneObject *obj;
+		glm::vec3 boundsMin, boundsMax;
+		unsigned int version;    // obj->worldVersion the box was computed for
+		int leaf;
+	};
+
+	void computeBounds(Item &item);
+	void buildNode(int node, int begin, int end);
+	void fitNode(Node &node);
+
+	std::vector<Node> nodes;
+	std::vector<Item> items;
+	BoxPackets itemBoxes;     // items[i] bounds, for the packet test of a leaf
+	std::vector<unsigned char> nodeDirty;
+};
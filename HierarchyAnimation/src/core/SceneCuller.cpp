@@ -0,0 +1,156 @@
+//
+//  SceneCuller.cpp - view frustum culling over the scene hierarchy
+//
+
+#include "SceneCuller.h"
+#include "SceneGraph.h"
+#include "BoundsRefit.h"
+#include <utility>
+
+// Gribb/Hartmann: the planes are sums and differences of the rows of the matrix
+//
+void Frustum::set(const glm::mat4 &m) {
+	glm::vec4 row[4];
+	for (int i = 0; i < 4; i++) row[i] = glm::vec4(m[0][i], m[1][i], m[2][i], m[3][i]);
+	for (int i = 0; i < 3; i++) {
+		planes[2 * i] = row[3] + row[i];
+		planes[2 * i + 1] = row[3] - row[i];
+	}
+}
+
+// map the rectangle (in normalized device coordinates) to the whole [-1, 1] square,
+// like gluPickMatrix, and take the planes of the result
+//
+Frustum Frustum::fromRect(const glm::mat4 &viewProjection, const glm::vec4 &viewport,
+	const glm::vec2 &corner0, const glm::vec2 &corner1) {
+
+	glm::vec2 lo = glm::min(corner0, corner1);
+	glm::vec2 hi = glm::max(corner0, corner1);
+	float x0 = (lo.x - viewport.x) / viewport.z * 2 - 1;
+	float x1 = (hi.x - viewport.x) / viewport.z * 2 - 1;
+	float y0 = 1 - (hi.y - viewport.y) / viewport.w * 2;
+	float y1 = 1 - (lo.y - viewport.y) / viewport.w * 2;
+
+	glm::mat4 pick(1.0);
+	pick[0][0] = 2 / (x1 - x0);
+	pick[1][1] = 2 / (y1 - y0);
+	pick[3][0] = -(x1 + x0) / (x1 - x0);
+	pick[3][1] = -(y1 + y0) / (y1 - y0);
+	return Frustum(pick * viewProjection);
+}
+
+// test the corner of the box furthest along each plane normal
+//
+bool Frustum::intersects(const glm::vec3 &boundsMin, const glm::vec3 &boundsMax) const {
+	for (int i = 0; i < 6; i++) {
+		const glm::vec4 &plane = planes[i];
+		glm::vec3 p(plane.x >= 0 ? boundsMax.x : boundsMin.x,
+			plane.y >= 0 ? boundsMax.y : boundsMin.y,
+			plane.z >= 0 ? boundsMax.z : boundsMin.z);
+		if (plane.x * p.x + plane.y * p.y + plane.z * p.z + plane.w < 0) return false;
+	}
+	return true;
+}
+
+void SceneCuller::clear() {
+	nodes.clear();
+	dirty.clear();
+	visibleObjects.clear();
+	culled = 0;
+}
+
+// depth first, iteratively (chains can be deeper than the call stack)
+//
+void SceneCuller::add(SceneObject *root) {
+	std::vector<std::pair<SceneObject *, int>> stack;
+	stack.push_back({ root, -1 });
+	int first = (int)nodes.size();
+	while (!stack.empty()) {
+		SceneObject *obj = stack.back().first;
+		int parent = stack.back().second;
+		stack.pop_back();
+
+		int index = (int)nodes.size();
+		Node node;
+		node.obj = obj;
+		node.parent = parent;
+		node.subtreeSize = 1;
+		computeBounds(node);
+		nodes.push_back(node);
+		for (auto child = obj->childList.rbegin(); child != obj->childList.rend(); ++child) {
+			stack.push_back({ *child, index });
+		}
+	}
+	for (int i = (int)nodes.size() - 1; i > first; i--) {
+		nodes[nodes[i].parent].subtreeSize += nodes[i].subtreeSize;
+	}
+}
+
+void SceneCuller::build(const std::vector<SceneObject *> &scene) {
+	clear();
+	nodes.reserve(scene.size());
+	for (SceneObject *obj : scene) {
+		if (obj->parent == NULL) add(obj);
+	}
+	for (int i = (int)nodes.size() - 1; i >= 0; i--) fitSubtree(i);
+	dirty.assign(nodes.size(), 0);
+}
+
+// world box of the object, including the origin of its parent (the bone)
+//
+void SceneCuller::computeBounds(Node &node) {
+	SceneObject *obj = node.obj;
+	glm::mat4 M = obj->getMatrix();
+	node.version = obj->worldVersion;
+
+	glm::vec3 localMin, localMax;
+	node.bBounded = obj->getLocalBounds(localMin, localMax);
+	if (!node.bBounded) return;
+	transformBounds(M, localMin, localMax, node.boundsMin, node.boundsMax);
+	if (obj->parent) {
+		glm::vec3 p = obj->parent->getPosition();
+		node.boundsMin = glm::min(node.boundsMin, p);
+		node.boundsMax = glm::max(node.boundsMax, p);
+	}
+}
+
+// subtree box from the object box and the subtree boxes of the children
+// (the children of node i start at i + 1 and are subtreeSize apart)
+//
+void SceneCuller::fitSubtree(int index) {
+	Node &node = nodes[index];
+	node.bSubtreeBounded = node.bBounded;
+	node.subtreeMin = node.boundsMin;
+	node.subtreeMax = node.boundsMax;
+	int end = index + node.subtreeSize;
+	for (int c = index + 1; c < end; c += nodes[c].subtreeSize) {
+		const Node &child = nodes[c];
+		node.bSubtreeBounded = node.bSubtreeBounded && child.bSubtreeBounded;
+		if (!node.bSubtreeBounded) break;
+		node.subtreeMin = glm::min(node.subtreeMin, child.subtreeMin);
+		node.subtreeMax = glm::max(node.subtreeMax, child.subtreeMax);
+	}
+}
+
+void SceneCuller::update() {
+	refitBounds(nodes, nodes, dirty,
+		[&](int i) { computeBounds(nodes[i]); return i; },
+		[&](int n) { fitSubtree(n); });
+}
+
+void SceneCuller::cull(const Frustum &frustum) {
+	visibleObjects.clear();
+	culled = 0;
+	int i = 0;
+	while (i < (int)nodes.size()) {
+		const Node &node = nodes[i];
+		if (node.bSubtreeBounded && !frustum.intersects(node.subtreeMin, node.subtreeMax)) {
+			culled += node.subtreeSize;
+			i += node.subtreeSize;
+			continue;
+		}
+		if (!node.bBounded || frustum.intersects(node.boundsMin, node.boundsMax)) visibleObjects.push_back(node.obj);
+		else culled++;
+		i++;
+	}
+}
@@ -0,0 +1,89 @@
+//
+//  SceneCuller.h - view frustum culling over the scene hierarchy
+//
+//  The scene is flattened in depth first order, so every subtree is a contiguous
+//  range.  Each object has a world space box (its local bounds, grown to reach its
+//  parent's origin so the bone drawn to the parent is covered) and each subtree a
+//  box around all of its objects.  update() recomputes the boxes of objects whose
+//  world matrix changed (SceneObject::worldVersion) and the subtree boxes above
+//  them; cull() then skips every subtree whose box is outside the frustum with a
+//  single test, so an off-screen skeleton costs one box test.
+//
+//  Objects without local bounds (e.g. the ground plane) are never culled.
+//
+#pragma once
+
+#include <vector>
+#include "glm/glm.hpp"
+
+class SceneObject;
+
+//  the six clip planes of a view projection matrix (OpenGL clip space),
+//  pointing inwards
+//
+class Frustum {
+public:
+	Frustum() {}
+	explicit Frustum(const glm::mat4 &viewProjection) { set(viewProjection); }
+	void set(const glm::mat4 &viewProjection);
+
+	// the part of the view behind a rectangle in window coordinates (y down,
+	// viewport is x, y, width, height), e.g. for marquee selection.  the
+	// rectangle must not be empty.
+	//
+	static Frustum fromRect(const glm::mat4 &viewProjection, const glm::vec4 &viewport,
+		const glm::vec2 &corner0, const glm::vec2 &corner1);
+
+	// false only if the box is completely outside one of the planes
+	// (conservative: some boxes near the corners pass although outside)
+	//
+	bool intersects(const glm::vec3 &boundsMin, const glm::vec3 &boundsMax) const;
+
+	glm::vec4 planes[6];
+};
+
+class SceneCuller {
+public:
+
+	// flatten the hierarchy.  must be called after objects are added, deleted
+	// or re-parented.
+	//
+	void build(const std::vector<SceneObject *> &scene);
+
+	// refresh the boxes of objects that moved since build()/update()
+	//
+	void update();
+
+	// collect the objects that intersect the frustum (see visible())
+	//
+	void cull(const Frustum &frustum);
+
+	// result of the last cull(), in depth first order
+	//
+	const std::vector<SceneObject *> &visible() const { return visibleObjects; }
+	int culledCount() const { return culled; }
+
+	void clear();
+	int size() const { return (int)nodes.size(); }
+
+private:
+	struct Node {
+		SceneObject *obj;
+		int parent;              // index, -1 for a root
+		int subtreeSize;         // this node and all of its descendants
+		bool bBounded;           // false => no local bounds, never culled
+		bool bSubtreeBounded;    // false => some object in the subtree is not bounded
+		unsigned int version;    // obj->worldVersion the box was computed for
+		glm::vec3 boundsMin, boundsMax;              // the object
+		glm::vec3 subtreeMin, subtreeMax;            // the object and its descendants
+	};
+
+	void add(SceneObject *root);
+	void computeBounds(Node &node);
+	void fitSubtree(int index);
+
+	std::vector<Node> nodes;
+	std::vector<unsigned char> dirty;
+	std::vector<SceneObject *> visibleObjects;
+	int culled = 0;
+};
@@ -0,0 +1,244 @@
+//
+//  SceneGenerator.cpp - synthetic skeletons and animation for stress testing
+//
+
+#include "SceneGenerator.h"
+#include <cmath>
+#include <random>
+#include <algorithm>
+#include "glm/gtc/matrix_transform.hpp"
+#include "glm/gtx/quaternion.hpp"
+
+// rest pose of the humanoid rig: parent index and offset from the parent
+//
+struct HumanoidBone {
+	const char *name;
+	int parent;
+	glm::vec3 offset;
+};
+
+static const HumanoidBone humanoid[] = {
+	{ "hips",       -1, glm::vec3(0, 3, 0) },
+	{ "spine",       0, glm::vec3(0, 0.8f, 0) },
+	{ "chest",       1, glm::vec3(0, 0.8f, 0) },
+	{ "neck",        2, glm::vec3(0, 0.6f, 0) },
+	{ "head",        3, glm::vec3(0, 0.4f, 0) },
+	{ "shoulderL",   2, glm::vec3(0.5f, 0.4f, 0) },
+	{ "armL",        5, glm::vec3(0.8f, 0, 0) },
+	{ "forearmL",    6, glm::vec3(0.9f, 0, 0) },
+	{ "shoulderR",   2, glm::vec3(-0.5f, 0.4f, 0) },
+	{ "armR",        8, glm::vec3(-0.8f, 0, 0) },
+	{ "forearmR",    9, glm::vec3(-0.9f, 0, 0) },
+	{ "thighL",      0, glm::vec3(0.4f, -0.2f, 0) },
+	{ "shinL",      11, glm::vec3(0, -1.3f, 0) },
+	{ "footL",      12, glm::vec3(0, -1.2f, 0.3f) },
+	{ "thighR",      0, glm::vec3(-0.4f, -0.2f, 0) },
+	{ "shinR",      14, glm::vec3(0, -1.3f, 0) },
+	{ "footR",      15, glm::vec3(0, -1.2f, 0.3f) },
+};
+static const int humanoidCount = sizeof(humanoid) / sizeof(humanoid[0]);
+
+bool parseSceneGenShape(const std::string &name, SceneGenShape &shape) {
+	if (name == "chain") shape = GEN_CHAIN;
+	else if (name == "fan") shape = GEN_FAN;
+	else if (name == "tree") shape = GEN_TREE;
+	else if (name == "humanoid") shape = GEN_HUMANOID;
+	else return false;
+	return true;
+}
+
+bool parseSceneGenCurve(const std::string &name, SceneGenCurve &curve) {
+	if (name == "sine") curve = GEN_SINE;
+	else if (name == "random") curve = GEN_RANDOM;
+	else if (name == "step") curve = GEN_STEP;
+	else return false;
+	return true;
+}
+
+// append one rig of the given shape; root is placed at origin
+//
+static void addRig(const SceneGenParams &params, int rig, const glm::vec3 &origin, std::vector<SceneJoint> &joints) {
+	int base = (int)joints.size();
+	std::string prefix = "rig" + std::to_string(rig) + "_";
+
+	if (params.shape == GEN_HUMANOID) {
+		for (int i = 0; i < humanoidCount; i++) {
+			SceneJoint joint;
+			joint.name = prefix + humanoid[i].name;
+			joint.parent = (humanoid[i].parent < 0 ? -1 : base + humanoid[i].parent);
+			joint.position = humanoid[i].offset + (humanoid[i].parent < 0 ? origin : glm::vec3(0));
+			joints.push_back(joint);
+		}
+		return;
+	}
+
+	int count = std::max(params.jointsPerRig, 1);
+	int branching = std::max(params.branching, 1);
+	for (int i = 0; i < count; i++) {
+		SceneJoint joint;
+		joint.name = prefix + "joint" + std::to_string(i);
+		if (i == 0) {
+			joint.position = origin;
+		}
+		else if (params.shape == GEN_CHAIN) {
+			joint.parent = base + i - 1;
+			joint.position = glm::vec3(0, 1, 0);
+		}
+		else if (params.shape == GEN_FAN) {
+			float a = i * 2.39996f;     // golden angle, spreads the children evenly
+			joint.parent = base;
+			joint.position = glm::vec3(std::cos(a), 1, std::sin(a)) * (1.0f + 0.01f * i);
+		}
+		else {
+
+			// breadth first: the children of joint p are p * branching + 1 ...
+			//
+			int p = (i - 1) / branching;
+			int k = (i - 1) % branching;
+			float a = (branching > 1 ? (k / (float)(branching - 1) - 0.5f) * 2.0f : 0.0f);
+			joint.parent = base + p;
+			joint.position = glm::vec3(a, 1, 0.3f * a);
+		}
+		joints.push_back(joint);
+	}
+}
+
+// fill in the keys of every joint
+//
+static void addKeys(const SceneGenParams &params, std::vector<SceneJoint> &joints) {
+	std::mt19937 rng(params.seed);
+	std::uniform_real_distribution<float> uniform(-1.0f, 1.0f);
+	int interval = std::max(params.keyInterval, 1);
+	const float twoPi = 6.28318531f;
+
+	std::vector<int> frames;
+	for (int f = params.frameBegin; f <= params.frameEnd; f += interval) frames.push_back(f);
+	if (frames.empty() || frames.back() != params.frameEnd) frames.push_back(params.frameEnd);
+
+	std::vector<int> depth(joints.size(), 0);
+	for (size_t j = 0; j < joints.size(); j++) {
+		SceneJoint &joint = joints[j];
+		joint.bQuatRotation = params.bQuatRotation;
+		if (joint.parent >= 0) depth[j] = depth[joint.parent] + 1;
+
+		glm::vec3 phase(uniform(rng), uniform(rng), uniform(rng));
+		joint.keyFrames.resize(frames.size());
+		for (size_t k = 0; k < frames.size(); k++) {
+			KeyFrame &key = joint.keyFrames[k];
+			key.frame = frames[k];
+			key.position = joint.position;
+			key.scale = joint.scale;
+
+			glm::vec3 v(0);
+			switch (params.curve) {
+			case GEN_SINE: {
+				float t = twoPi * (frames[k] - params.frameBegin) / std::max(params.period, 1.0f) - 0.5f * depth[j];
+				v = glm::vec3(std::sin(t + phase.x), std::sin(t + phase.y), std::sin(t + phase.z));
+				break;
+			}
+			case GEN_RANDOM:
+				v = glm::vec3(uniform(rng), uniform(rng), uniform(rng));
+				break;
+			case GEN_STEP:
+				v = glm::vec3((k & 1 ? 1.0f : -1.0f));
+				break;
+			}
+			key.rotation = v * params.amplitude;
+			key.orientation = keyEulerToQuat(key.rotation);
+
+			// roots also move, so the rigs do not only spin in place
+			//
+			if (joint.parent < 0) key.position += glm::vec3(0, 0.25f * v.x, 0);
+		}
+
+		// rest pose = first key, like the app after loading
+		//
+		joint.rotation = joint.keyFrames[0].rotation;
+		joint.orientation = joint.keyFrames[0].orientation;
+		joint.position = joint.keyFrames[0].position;
+	}
+}
+
+// world matrices of the joints' rest pose (same channels as SceneObject::getLocalMatrix(),
+// without pivot)
+//
+static void restPose(const std::vector<SceneJoint> &joints, std::vector<glm::mat4> &world) {
+	world.resize(joints.size());
+	for (size_t i = 0; i < joints.size(); i++) {
+		const SceneJoint &joint = joints[i];
+		glm::quat q = (joint.bQuatRotation ? joint.orientation : keyEulerToQuat(joint.rotation));
+		glm::mat4 local = glm::translate(glm::mat4(1.0), joint.position) * glm::toMat4(q) * glm::scale(glm::mat4(1.0), joint.scale);
+		world[i] = (joint.parent >= 0 ? world[joint.parent] * local : local);
+	}
+}
+
+void generateSkin(const std::vector<SceneJoint> &joints, SkinnedMesh &mesh, float radius) {
+	const int rings = 8;
+	const int sides = 12;
+	const float twoPi = 6.28318531f;
+
+	mesh.clear();
+	std::vector<glm::mat4> world;
+	restPose(joints, world);
+	size_t boneCount = std::min(joints.size(), (size_t)65536);
+	for (size_t i = 0; i < boneCount; i++) mesh.boneNames.push_back(joints[i].name);
+
+	for (size_t j = 0; j < boneCount; j++) {
+		int p = joints[j].parent;
+		if (p < 0) continue;
+		int grandParent = joints[p].parent;
+		glm::vec3 a = world[p][3];
+		glm::vec3 b = world[j][3];
+		if (glm::length(b - a) < 1e-5f) continue;
+
+		glm::vec3 d = glm::normalize(b - a);
+		glm::vec3 u = glm::normalize(glm::cross(d, std::fabs(d.y) < 0.99f ? glm::vec3(0, 1, 0) : glm::vec3(1, 0, 0)));
+		glm::vec3 v = glm::cross(d, u);
+
+		uint32_t first = (uint32_t)mesh.positions.size();
+		for (int r = 0; r < rings; r++) {
+			float t = r / (float)(rings - 1);
+
+			// the bone follows its parent joint; towards each end half of the
+			// weight moves to the joint on the other side of the bend
+			//
+			float wChild = std::max(0.0f, t - 0.5f);
+			float wGrandParent = (grandParent >= 0 ? std::max(0.0f, 0.5f - t) : 0.0f);
+			float wParent = 1.0f - wChild - wGrandParent;
+
+			glm::vec3 center = a + (b - a) * t;
+			for (int s = 0; s < sides; s++) {
+				float angle = twoPi * s / sides;
+				glm::vec3 n = u * std::cos(angle) + v * std::sin(angle);
+				mesh.positions.push_back(center + n * radius);
+				mesh.normals.push_back(n);
+				uint16_t bone[4] = { (uint16_t)p, (uint16_t)j, (uint16_t)std::max(grandParent, 0), 0 };
+				float weight[4] = { wParent, wChild, wGrandParent, 0 };
+				mesh.bones.insert(mesh.bones.end(), bone, bone + 4);
+				mesh.weights.insert(mesh.weights.end(), weight, weight + 4);
+			}
+		}
+		for (int r = 0; r + 1 < rings; r++) {
+			for (int s = 0; s < sides; s++) {
+				uint32_t i0 = first + r * sides + s;
+				uint32_t i1 = first + r * sides + (s + 1) % sides;
+				uint32_t i2 = i0 + sides;
+				uint32_t i3 = i1 + sides;
+				uint32_t quad[6] = { i0, i1, i3, i0, i3, i2 };
+				mesh.indices.insert(mesh.indices.end(), quad, quad + 6);
+			}
+		}
+	}
+}
+
+void generateScene(const SceneGenParams &params, std::vector<SceneJoint> &joints) {
+	joints.clear();
+	int copies = std::max(params.copies, 1);
+	int side = (int)std::ceil(std::sqrt((float)copies));
+	float spacing = (params.shape == GEN_HUMANOID ? 4.0f : 10.0f);
+	for (int c = 0; c < copies; c++) {
+		glm::vec3 origin((c % side - (side - 1) * 0.5f) * spacing, 0, (c / side - (side - 1) * 0.5f) * spacing);
+		addRig(params, c, origin, joints);
+	}
+	addKeys(params, joints);
+}
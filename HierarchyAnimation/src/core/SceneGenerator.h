@@ -0,0 +1,59 @@
+//
+//  SceneGenerator.h - synthetic skeletons and animation for stress testing
+//
+//  Produces a joint list (parents before children, see SceneIO.h) that can be
+//  written with writeTextScene()/writeAnimFile() and read back by the app's loader.
+//  The same parameters and seed always produce the same scene.
+//
+//    chain      every joint is the child of the previous one
+//    fan        one root, all other joints are its children
+//    tree       balanced tree with the given branching factor (breadth first)
+//    humanoid   17 joint biped: spine, neck/head, arms, legs
+//
+//  copies rigs of the chosen shape are laid out on a grid; each has jointsPerRig
+//  joints (ignored for humanoid).  Every joint gets a key every keyInterval frames
+//  over [frameBegin, frameEnd] (and on frameEnd); the key values follow curve.
+//
+#pragma once
+
+#include <string>
+#include <vector>
+#include "SceneIO.h"
+#include "SkinnedMesh.h"
+
+enum SceneGenShape { GEN_CHAIN, GEN_FAN, GEN_TREE, GEN_HUMANOID };
+enum SceneGenCurve {
+	GEN_SINE,       // smooth oscillation, phase shifted along the hierarchy
+	GEN_RANDOM,     // uniform random values in [-amplitude, amplitude]
+	GEN_STEP        // alternating between -amplitude and amplitude
+};
+
+struct SceneGenParams {
+	SceneGenShape shape = GEN_TREE;
+	int jointsPerRig = 1000;
+	int branching = 3;            // tree only
+	int copies = 1;
+
+	int frameBegin = 1;
+	int frameEnd = 500;
+	int keyInterval = 25;         // frames between keys (key density)
+	SceneGenCurve curve = GEN_SINE;
+	float amplitude = 30.0f;      // degrees of rotation
+	float period = 100.0f;        // frames, sine only
+	bool bQuatRotation = false;   // quaternion rotation channel
+	unsigned int seed = 1;
+};
+
+void generateScene(const SceneGenParams &params, std::vector<SceneJoint> &joints);
+
+// a skin for joints (at their rest pose): an open tube around every bone, weighted
+// to the joint at each end of the bone and blended half way towards the
+// neighbouring bones.  Bones are named after the joints.
+//
+void generateSkin(const std::vector<SceneJoint> &joints, SkinnedMesh &mesh, float radius = 0.15f);
+
+// names used on the command line ("chain", "fan", "tree", "humanoid" /
+// "sine", "random", "step").  return false for an unknown name.
+//
+bool parseSceneGenShape(const std::string &name, SceneGenShape &shape);
+bool parseSceneGenCurve(const std::string &name, SceneGenCurve &curve);
@@ -0,0 +1,90 @@
+//
+//  SceneGraph.cpp - scene objects with hierarchical transformations, and animated joints
+//
+//  (c) Kevin M. Smith  - 24 September 2018
+//
+
+#include "SceneGraph.h"
+#include "BoxKernels.h"
+#include "glm/gtx/vector_angle.hpp"
+
+// Generate a rotation matrix that rotates v1 to v2
+// v1, v2 must be normalized
+//
+glm::mat4 SceneObject::rotateToVector(glm::vec3 v1, glm::vec3 v2) {
+
+	glm::vec3 axis = glm::cross(v1, v2);
+	glm::quat q = glm::angleAxis(glm::angle(v1, v2), glm::normalize(axis));
+	return glm::toMat4(q);
+}
+
+// Intersect a world space ray with the object's local bounds.  The ray is
+// moved to object space without normalizing the direction, so the slab test
+// returns the same parameter t as along the world space ray.
+//
+bool SceneObject::intersectRay(const Ray &ray, float &t) {
+	glm::vec3 boundsMin, boundsMax;
+	if (!getLocalBounds(boundsMin, boundsMax)) return false;
+
+	Ray local = toObjectSpace(ray);
+	float tNear = 0, tFar = std::numeric_limits<float>::infinity();
+	if (!intersectRayBox(local.p, rayInverse(local.d), boundsMin, boundsMax, tNear, tFar)) return false;
+	t = tNear;
+	return true;
+}
+
+
+// same as Sphere::intersect(): the normal is returned in object space
+//
+bool Joint::intersect(const Ray &ray, glm::vec3 &point, glm::vec3 &normal) {
+
+	// transform Ray to object space.  
+	//
+	Ray local = toObjectSpace(ray);
+	return (glm::intersectRaySphere(local.p, glm::normalize(local.d), glm::vec3(0, 0, 0), radius, point, normal));
+}
+
+// same as SceneObject::intersectRay(), but against the sphere itself
+//
+bool Joint::intersectRay(const Ray &ray, float &t) {
+	Ray local = toObjectSpace(ray);
+	return intersectRaySphere(local.p, local.d, radius, t);
+}
+
+// insert key in frame order, replacing any key already set at that frame
+//
+void Joint::setKey(const KeyFrame &key) {
+	auto it = std::lower_bound(keyFrames.begin(), keyFrames.end(), key.frame,
+		[](const KeyFrame &k, int f) { return k.frame < f; });
+	if (it != keyFrames.end() && it->frame == key.frame) *it = key;
+	else keyFrames.insert(it, key);
+}
+
+bool Joint::deleteKey(int frame) {
+	auto it = std::lower_bound(keyFrames.begin(), keyFrames.end(), frame,
+		[](const KeyFrame &k, int f) { return k.frame < f; });
+	if (it == keyFrames.end() || it->frame != frame) return false;
+	keyFrames.erase(it);
+	return true;
+}
+
+int Joint::findSegment(int frame) {
+	int n = (int)keyFrames.size();
+	if (n < 2 || frame < keyFrames[0].frame || frame > keyFrames[n - 1].frame) return -1;
+
+	// try the cached segment and its neighbours first (playback)
+	//
+	auto inSegment = [&](int i) {
+		return (i >= 0 && i < n - 1 && frame >= keyFrames[i].frame && frame <= keyFrames[i + 1].frame);
+	};
+	if (inSegment(keyCursor)) return keyCursor;
+	if (inSegment(keyCursor + 1)) return ++keyCursor;
+	if (inSegment(keyCursor - 1)) return --keyCursor;
+
+	// random access (scrubbing): last key at or before frame
+	//
+	auto it = std::upper_bound(keyFrames.begin(), keyFrames.end(), frame,
+		[](int f, const KeyFrame &k) { return f < k.frame; });
+	keyCursor = std::min((int)(it - keyFrames.begin()) - 1, n - 2);
+	return keyCursor;
+}
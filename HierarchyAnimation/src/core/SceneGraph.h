@@ -0,0 +1,391 @@
+//
+//  SceneGraph.h - scene objects with hierarchical transformations, and animated joints
+//
+//  This is the window independent part of Primitives.h: transforms, hierarchy,
+//  picking and keyframes.  It only depends on GLM and the standard library, so it
+//  can be used without a GL context (see CMakeLists.txt); the drawable primitives
+//  in Primitives.h derive from these classes.
+//
+//  (c) Kevin M. Smith  - 24 September 2018
+//
+#pragma once
+
+#include <cmath>
+#include <cstdint>
+#include <string>
+#include <vector>
+#include <limits>
+#include <algorithm>
+#include "glm/glm.hpp"
+#include "glm/gtc/matrix_transform.hpp"
+#include "glm/gtc/matrix_inverse.hpp"
+#include "glm/gtc/quaternion.hpp"
+#include "glm/gtx/quaternion.hpp"
+#include "glm/gtx/euler_angles.hpp"
+#include "glm/gtx/intersect.hpp"
+#include "KeyFrame.h"
+
+class SceneRenderer;
+
+//  Reference to an object owned by a SceneArena (see SceneArena.h).  Unlike a
+//  pointer it can be kept across deletes and scene reloads: a handle of an object
+//  that no longer exists resolves to NULL.
+//
+struct SceneHandle {
+	uint32_t index = 0;          // pool in the top 8 bits, slot in the pool below
+	uint32_t generation = 0;     // 0 => null handle
+
+	bool isNull() const { return generation == 0; }
+	bool operator==(const SceneHandle &h) const { return index == h.index && generation == h.generation; }
+	bool operator!=(const SceneHandle &h) const { return !(*this == h); }
+};
+
+//  General Purpose Ray class 
+//
+class Ray {
+public:
+	Ray(glm::vec3 p, glm::vec3 d) { this->p = p; this->d = d; }
+
+	glm::vec3 evalPoint(float t) {
+		return (p + t * d);
+	}
+
+	glm::vec3 p, d;
+};
+
+//  slab test of a ray (origin, 1 / direction) against an axis aligned box.
+//  on a hit, [tNear, tFar] is clipped to the part of the ray inside the box.
+//
+inline bool intersectRayBox(const glm::vec3 &origin, const glm::vec3 &invDir,
+	const glm::vec3 &boundsMin, const glm::vec3 &boundsMax, float &tNear, float &tFar) {
+	for (int i = 0; i < 3; i++) {
+		float t0 = (boundsMin[i] - origin[i]) * invDir[i];
+		float t1 = (boundsMax[i] - origin[i]) * invDir[i];
+		if (t0 > t1) std::swap(t0, t1);
+		tNear = (t0 > tNear ? t0 : tNear);     // NaN (0 * inf) leaves the interval unchanged
+		tFar = (t1 < tFar ? t1 : tFar);
+		if (tNear > tFar) return false;
+	}
+	return true;
+}
+
+//  axis aligned box around the box (boundsMin, boundsMax) transformed by M
+//  (transformed center and extents)
+//
+inline void transformBounds(const glm::mat4 &M, const glm::vec3 &boundsMin, const glm::vec3 &boundsMax,
+	glm::vec3 &outMin, glm::vec3 &outMax) {
+	glm::vec3 center = (boundsMin + boundsMax) * 0.5f;
+	glm::vec3 extent = (boundsMax - boundsMin) * 0.5f;
+	glm::vec3 worldCenter = M * glm::vec4(center, 1.0);
+	glm::vec3 worldExtent;
+	for (int i = 0; i < 3; i++) {
+		worldExtent[i] = std::fabs(M[0][i]) * extent.x + std::fabs(M[1][i]) * extent.y + std::fabs(M[2][i]) * extent.z;
+	}
+	outMin = worldCenter - worldExtent;
+	outMax = worldCenter + worldExtent;
+}
+
+//  ray (origin, direction, not necessarily normalized) against a sphere of the
+//  given radius at the origin.  t is the parameter of the nearest hit at or
+//  after the origin (0 if the ray starts inside, like the box test).
+//
+inline bool intersectRaySphere(const glm::vec3 &origin, const glm::vec3 &dir, float radius, float &t) {
+
+	// solve |origin + t * dir|^2 = radius^2 for the smallest t >= 0
+	//
+	float a = glm::dot(dir, dir);
+	float b = glm::dot(origin, dir);
+	float c = glm::dot(origin, origin) - radius * radius;
+	float disc = b * b - a * c;
+	if (a == 0 || disc < 0) return false;
+	float root = std::sqrt(disc);
+	float t0 = (-b - root) / a;
+	float t1 = (-b + root) / a;
+	if (t1 < 0) return false;
+	t = (t0 >= 0 ? t0 : 0);
+	return true;
+}
+
+//  Base class for any object in the scene
+//
+class SceneObject {
+public: 
+	virtual ~SceneObject() {}
+
+	// drawing is implemented by the drawable primitives (Primitives.h);
+	// objects of the core classes are invisible.
+	//
+	virtual void draw() {}
+
+	// add this object to the instanced renderer (see SceneRenderer.h)
+	//
+	virtual void submit(SceneRenderer & /*renderer*/, bool /*bSelected*/) {}
+	virtual bool intersect(const Ray & /*ray*/, glm::vec3 & /*point*/, glm::vec3 & /*normal*/) { return false; }
+
+	// object space bounding box, used for picking (see SceneBVH).
+	// returns false if the object has no finite extent.
+	//
+	virtual bool getLocalBounds(glm::vec3 & /*boundsMin*/, glm::vec3 & /*boundsMax*/) { return false; }
+
+	// intersect a world space ray and return the ray parameter t of the nearest
+	// hit in front of ray.p.  The default tests the local bounds in object space.
+	//
+	virtual bool intersectRay(const Ray &ray, float &t);
+
+	// commonly used transformations
+	//
+	glm::mat4 getRotateMatrix() {
+		if (bQuatRotation) return (glm::toMat4(orientation));
+		return (glm::eulerAngleYXZ(glm::radians(rotation.y), glm::radians(rotation.x), glm::radians(rotation.z)));   // yaw, pitch, roll 
+	}
+	glm::quat getRotationQuat() {
+		if (bQuatRotation) return orientation;
+		return eulerToQuat(rotation);
+	}
+
+	// rotation in Euler degrees, for display and editing
+	//
+	glm::vec3 getEulerRotation() {
+		if (bQuatRotation) return quatToEuler(orientation);
+		return rotation;
+	}
+
+	// Euler degrees (yaw, pitch, roll applied as Y * X * Z) <=> quaternion
+	//
+	static glm::quat eulerToQuat(const glm::vec3 &r) { return keyEulerToQuat(r); }
+	static glm::vec3 quatToEuler(const glm::quat &q) {
+		float y, x, z;
+		glm::extractEulerAngleYXZ(glm::toMat4(q), y, x, z);
+		return glm::degrees(glm::vec3(x, y, z));
+	}
+
+	glm::mat4 getTranslateMatrix() {
+		return (glm::translate(glm::mat4(1.0), glm::vec3(position.x, position.y, position.z)));
+	}
+	glm::mat4 getScaleMatrix() {
+		return (glm::scale(glm::mat4(1.0), glm::vec3(scale.x, scale.y, scale.z)));
+	}
+
+
+	glm::mat4 getLocalMatrix() {
+
+		// the local matrix is cached and only rebuilt after one of the
+		// transform channels has been changed (see markDirty())
+		//
+		if (!bLocalDirty) return localMatrix;
+
+		// get the local transformations + pivot
+		//
+		glm::mat4 scale = getScaleMatrix();
+		glm::mat4 rotate = getRotateMatrix();
+		glm::mat4 trans = getTranslateMatrix();
+
+		// handle pivot point  (rotate around a point that is not the object's center)
+		//
+		glm::mat4 pre = glm::translate(glm::mat4(1.0), glm::vec3(-pivot.x, -pivot.y, -pivot.z));
+		glm::mat4 post = glm::translate(glm::mat4(1.0), glm::vec3(pivot.x, pivot.y, pivot.z));
+
+	
+
+		localMatrix = (trans * post * rotate * pre * scale);
+		bLocalDirty = false;
+		return localMatrix;
+
+	}
+
+	glm::mat4 getMatrix() {
+
+		// world matrix is cached as well; it is invalidated whenever this object
+		// or any of its ancestors changes, so a clean parent is never walked again.
+		//
+		if (!bWorldDirty) return worldMatrix;
+
+		// if we have a parent (we are not the root),
+		// concatenate parent's transform (this is recursive)
+		// 
+		if (parent) {
+			glm::mat4 M = parent->getMatrix();
+			worldMatrix = (M * getLocalMatrix());
+		}
+		else worldMatrix = getLocalMatrix();  // priority order is SRT
+		bWorldDirty = false;
+		bInverseDirty = true;
+		worldVersion++;
+		return worldMatrix;
+	}
+
+	// inverse of the world matrix, cached with it.  world matrices are affine,
+	// so the inverse only needs the 3x3 part inverted.
+	//
+	const glm::mat4 &getInverseMatrix() {
+		getMatrix();
+		if (bInverseDirty) {
+			inverseWorldMatrix = glm::affineInverse(worldMatrix);
+			bInverseDirty = false;
+		}
+		return inverseWorldMatrix;
+	}
+
+	// world space ray moved to object space.  the direction is not normalized,
+	// so a parameter t along it is the same point as t along the world space ray.
+	//
+	Ray toObjectSpace(const Ray &ray) {
+		const glm::mat4 &m = getInverseMatrix();
+		return Ray(glm::vec3(m * glm::vec4(ray.p, 1.0)), glm::mat3(m) * ray.d);
+	}
+
+	// invalidate cached matrices.  Call this after writing position, rotation,
+	// scale or pivot directly (the set* functions below do it for you).
+	//
+	void markDirty() {
+		bLocalDirty = true;
+		markWorldDirty();
+	}
+
+	// invalidate the world matrix of this object and its whole subtree.
+	// a dirty object always has a dirty subtree, so we can stop early.
+	//
+	void markWorldDirty() {
+		if (bWorldDirty) return;
+		bWorldDirty = true;
+		for (auto child : childList) child->markWorldDirty();
+	}
+
+	// store a world matrix computed elsewhere (see SkeletonPose::push()).
+	// caller guarantees it matches the current channels and parent.
+	// worldVersion only moves if the matrix does, so a published pose that
+	// leaves an object in place does not make it look moved (see SceneBVH,
+	// SceneCuller, SkinPalette).
+	//
+	void setWorldMatrix(const glm::mat4 &m) {
+		bWorldDirty = false;
+		if (m == worldMatrix) return;
+		worldMatrix = m;
+		bInverseDirty = true;
+		worldVersion++;
+	}
+
+	void setLocalPosition(const glm::vec3 &p) { position = p; markDirty(); }
+	void setRotation(const glm::vec3 &r) {
+		if (bQuatRotation) orientation = eulerToQuat(r);
+		else rotation = r;
+		markDirty();
+	}
+	void setOrientation(const glm::quat &q) { orientation = q; markDirty(); }
+	void setScale(const glm::vec3 &s) { scale = s; markDirty(); }
+	void setPivot(const glm::vec3 &p) { pivot = p; markDirty(); }
+
+	// rotate by an Euler increment (degrees).  quaternion objects apply it
+	// as an incremental rotation, so they never pass through a gimbal lock.
+	//
+	void addRotation(const glm::vec3 &delta) {
+		if (bQuatRotation) setOrientation(glm::normalize(orientation * eulerToQuat(delta)));
+		else setRotation(rotation + delta);
+	}
+
+	// switch between the Euler and the quaternion rotation channel,
+	// keeping the current orientation.
+	//
+	void useQuatRotation(bool bUse) {
+		if (bUse == bQuatRotation) return;
+		if (bUse) orientation = eulerToQuat(rotation);
+		else rotation = quatToEuler(orientation);
+		bQuatRotation = bUse;
+		markDirty();
+	}
+
+	// get current Position in World Space
+	//
+	glm::vec3 getPosition() {
+		return (getMatrix() * glm::vec4(0.0, 0.0, 0.0, 1.0));
+	}
+
+	// set position (pos is in world space)
+	//
+	void setPosition(glm::vec3 pos) {
+		position = getInverseMatrix() * glm::vec4(pos, 1.0);
+		markDirty();
+	}
+
+	// return a rotation  matrix that rotates one vector to another
+	//
+	glm::mat4 rotateToVector(glm::vec3 v1, glm::vec3 v2);
+
+	//  Hierarchy 
+	//
+	void addChild(SceneObject *child) {
+		childList.push_back(child);
+		child->parent = this;
+		child->markWorldDirty();
+	}
+
+	SceneObject *parent = NULL;        // if parent = NULL, then this obj is the ROOT
+	std::vector<SceneObject *> childList;
+
+	// position/orientation 
+	// (call markDirty() after writing these directly)
+	//
+	glm::vec3 position = glm::vec3(0, 0, 0);   // translate
+	glm::vec3 rotation = glm::vec3(0, 0, 0);   // rotate
+	glm::quat orientation = glm::quat(1, 0, 0, 0);   // rotate (if bQuatRotation)
+	bool bQuatRotation = false;   // true => orientation is used instead of Euler rotation
+	glm::vec3 scale = glm::vec3(1, 1, 1);      // scale
+
+	// rotate pivot
+	//
+	glm::vec3 pivot = glm::vec3(0, 0, 0);
+
+	// cached transforms (rebuilt lazily by getLocalMatrix()/getMatrix())
+	//
+	glm::mat4 localMatrix = glm::mat4(1.0);
+	glm::mat4 worldMatrix = glm::mat4(1.0);
+	glm::mat4 inverseWorldMatrix = glm::mat4(1.0);
+	bool bLocalDirty = true;
+	bool bWorldDirty = true;
+	bool bInverseDirty = true;         // inverseWorldMatrix is older than worldMatrix
+	unsigned int worldVersion = 0;     // incremented whenever worldMatrix is rebuilt
+
+
+	// UI parameters
+	//
+	bool isSelectable = true;
+	bool isSelected = false;
+	std::string name = "SceneObject";
+
+	// set by the SceneArena that owns the object (null for objects created with new)
+	//
+	SceneHandle handle;
+};
+
+//  Joint of an animated skeleton: a sphere of the given radius with keyframes.
+//  The app draws joints as JointShape (Primitives.h).
+//
+class Joint: public SceneObject {
+public:
+	Joint(const std::string& name, float r) { this->name = name; radius = r; }
+	Joint() {}
+	bool intersect(const Ray &ray, glm::vec3 &point, glm::vec3 &normal);
+	bool intersectRay(const Ray &ray, float &t);
+	bool getLocalBounds(glm::vec3 &boundsMin, glm::vec3 &boundsMax) {
+		boundsMin = glm::vec3(-radius);
+		boundsMax = glm::vec3(radius);
+		return true;
+	}
+
+	// keyframes are kept sorted by frame, at most one key per frame.
+	// use setKey()/deleteKey() rather than editing keyFrames directly.
+	//
+	void setKey(const KeyFrame &key);
+	bool deleteKey(int frame);
+
+	// index i of the segment (keyFrames[i], keyFrames[i + 1]) that contains frame,
+	// -1 if frame is outside the keyed range.  Starts from the segment found by
+	// the previous call, so stepping forward or backward is O(1); random access
+	// falls back to a binary search.
+	//
+	int findSegment(int frame);
+
+	float radius = 1.0f;
+	std::vector<KeyFrame> keyFrames;
+	int keyCursor = 0;     // segment found by the last findSegment() call
+};
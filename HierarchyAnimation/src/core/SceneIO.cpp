@@ -0,0 +1,454 @@
+//
+//  SceneIO.cpp - reading and writing joint hierarchies with their keyframes
+//
+
+#include "SceneIO.h"
+#include <fstream>
+#include <iostream>
+#include <cstring>
+#include <cstddef>
+#include <type_traits>
+#include <algorithm>
+#include <charconv>
+#include <chrono>
+#include <string_view>
+#include <unordered_map>
+
+#ifdef _WIN32
+#define WIN32_LEAN_AND_MEAN
+#define NOMINMAX
+#include <windows.h>
+#else
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <fcntl.h>
+#include <unistd.h>
+#endif
+
+static_assert(sizeof(AnimFileHeader) == 40, "AnimFileHeader must be packed");
+static_assert(sizeof(AnimJointEntry) == 76, "AnimJointEntry must be packed");
+static_assert(sizeof(AnimKeyRecord) == 56, "AnimKeyRecord must be packed");
+
+// key records are copied straight into KeyFrames (and back), so both must
+// have the same layout.  glm::quat stores x, y, z, w like the file does
+// (unless GLM_FORCE_QUAT_DATA_WXYZ is defined).
+//
+static_assert(sizeof(KeyFrame) == sizeof(AnimKeyRecord), "KeyFrame must match AnimKeyRecord");
+static_assert(offsetof(KeyFrame, frame) == offsetof(AnimKeyRecord, frame) &&
+	offsetof(KeyFrame, position) == offsetof(AnimKeyRecord, position) &&
+	offsetof(KeyFrame, rotation) == offsetof(AnimKeyRecord, rotation) &&
+	offsetof(KeyFrame, orientation) == offsetof(AnimKeyRecord, orientation) &&
+	offsetof(KeyFrame, scale) == offsetof(AnimKeyRecord, scale), "KeyFrame must match AnimKeyRecord");
+static_assert(offsetof(glm::quat, x) == 0 && offsetof(glm::quat, w) == 12, "glm::quat must be stored x, y, z, w");
+static_assert(std::is_trivially_copyable<KeyFrame>::value, "KeyFrame must be trivially copyable");
+
+bool isAnimFilePath(const std::string &path) {
+	const std::string ext = ".hanim";
+	if (path.size() < ext.size()) return false;
+	std::string tail = path.substr(path.size() - ext.size());
+	std::transform(tail.begin(), tail.end(), tail.begin(), ::tolower);
+	return (tail == ext);
+}
+
+//--------------------------------------------------------------
+// text format
+//
+bool writeTextScene(const std::string &path, const std::vector<SceneJoint> &joints) {
+	std::ofstream file(path);
+	if (!file.is_open()) {
+		std::cerr << "File could not be opened for saving: " << path << std::endl;
+		return false;
+	}
+
+	for (const auto &joint : joints) {
+		file << "Joint: " << joint.name << std::endl;
+		file << "Parent: " << (joint.parent >= 0 ? joints[joint.parent].name : "None") << std::endl;
+		file << "Position: (" << joint.position.x << ", " << joint.position.y << ", " << joint.position.z << ")" << std::endl;
+		file << "Rotation: (" << joint.rotation.x << ", " << joint.rotation.y << ", " << joint.rotation.z << ")" << std::endl;
+		if (joint.bQuatRotation) {
+			file << "Orientation: (" << joint.orientation.w << ", " << joint.orientation.x << ", " << joint.orientation.y << ", " << joint.orientation.z << ")" << std::endl;
+		}
+		file << "Scale: (" << joint.scale.x << ", " << joint.scale.y << ", " << joint.scale.z << ")" << std::endl;
+
+		// write keyframe data
+		if (!joint.keyFrames.empty()) {
+			file << "KeyFrames:" << std::endl;
+			for (const auto &kf : joint.keyFrames) {
+				file << "  Frame: " << kf.frame << std::endl;
+				file << "    Position: (" << kf.position.x << ", " << kf.position.y << ", " << kf.position.z << ")" << std::endl;
+				file << "    Rotation: (" << kf.rotation.x << ", " << kf.rotation.y << ", " << kf.rotation.z << ")" << std::endl;
+				if (joint.bQuatRotation) {
+					file << "    Orientation: (" << kf.orientation.w << ", " << kf.orientation.x << ", " << kf.orientation.y << ", " << kf.orientation.z << ")" << std::endl;
+				}
+				file << "    Scale: (" << kf.scale.x << ", " << kf.scale.y << ", " << kf.scale.z << ")" << std::endl;
+			}
+		}
+		file << std::endl;
+	}
+	return true;
+}
+
+static bool isBlank(char c) { return (c == ' ' || c == '\t' || c == '\r' || c == '\v' || c == '\f'); }
+
+// next whitespace separated token of [p, end); p is left after the token
+//
+static std::string_view nextToken(const char *&p, const char *end) {
+	while (p < end && isBlank(*p)) p++;
+	const char *start = p;
+	while (p < end && !isBlank(*p)) p++;
+	return std::string_view(start, p - start);
+}
+
+// read count numbers of a "(x, y, z)" tuple.  Components that can't be
+// parsed are left as they are.
+//
+static void parseFloats(const char *p, const char *end, float *out, int count) {
+	for (int i = 0; i < count; i++) {
+		while (p < end && (isBlank(*p) || *p == '(' || *p == ',' || *p == ')')) p++;
+		if (p < end && *p == '+') p++;
+		auto result = std::from_chars(p, end, out[i]);
+		if (result.ec != std::errc()) return;
+		p = result.ptr;
+	}
+}
+
+static void parseVec3(const char *p, const char *end, glm::vec3 &v) {
+	float f[3] = { v.x, v.y, v.z };
+	parseFloats(p, end, f, 3);
+	v = glm::vec3(f[0], f[1], f[2]);
+}
+
+// written as (w, x, y, z)
+//
+static void parseQuat(const char *p, const char *end, glm::quat &q) {
+	float f[4] = { q.w, q.x, q.y, q.z };
+	parseFloats(p, end, f, 4);
+	q = glm::quat(f[0], f[1], f[2], f[3]);
+}
+
+// keep keys sorted by frame; files written by writeTextScene() are already
+// sorted, so this is almost always an append.
+//
+static void addKey(std::vector<KeyFrame> &keys, const KeyFrame &key) {
+	if (keys.empty() || keys.back().frame < key.frame) {
+		keys.push_back(key);
+		return;
+	}
+	auto it = std::lower_bound(keys.begin(), keys.end(), key.frame,
+		[](const KeyFrame &k, int f) { return k.frame < f; });
+	if (it != keys.end() && it->frame == key.frame) *it = key;
+	else keys.insert(it, key);
+}
+
+bool parseTextScene(const char *begin, const char *end, std::vector<SceneJoint> &joints) {
+	std::unordered_map<std::string_view, int> names;   // views into the buffer
+	SceneJoint *joint = NULL;
+	KeyFrame key;
+	bool bInKey = false;            // inside a "Frame:" block
+	bool bKeyOrientation = false;
+
+	// files written before the quaternion channel only have Euler keys
+	//
+	auto finishKey = [&]() {
+		if (!bInKey) return;
+		if (!bKeyOrientation) key.orientation = keyEulerToQuat(key.rotation);
+		addKey(joint->keyFrames, key);
+		bInKey = false;
+	};
+
+	const char *line = begin;
+	while (line < end) {
+		const char *lineEnd = (const char *)memchr(line, '\n', end - line);
+		if (lineEnd == NULL) lineEnd = end;
+		const char *p = line;
+		line = lineEnd + 1;
+
+		std::string_view word = nextToken(p, lineEnd);
+
+		// a blank line ends a key block
+		//
+		if (word.empty()) {
+			finishKey();
+			continue;
+		}
+
+		if (word == "Joint:") {
+			finishKey();
+			joints.emplace_back();
+			joint = &joints.back();
+			std::string_view name = nextToken(p, lineEnd);
+			joint->name = std::string(name);
+			names[name] = (int)joints.size() - 1;
+		}
+		else if (joint == NULL) {
+			continue;
+		}
+		else if (word == "Parent:") {
+
+			// the joint itself is already in names, so only accept joints
+			// before it: a self or forward parent would break parents-first.
+			// Like the old loader, such a joint becomes a root.
+			//
+			std::string_view parentName = nextToken(p, lineEnd);
+			if (parentName == "None") continue;
+			auto it = names.find(parentName);
+			if (it == names.end() || it->second >= (int)joints.size() - 1) {
+				std::cerr << "Warning: joint " << joint->name << " has parent " << parentName
+					<< ", which is not an earlier joint; loaded as a root" << std::endl;
+				continue;
+			}
+			joint->parent = it->second;
+		}
+		else if (word == "Frame:") {
+			finishKey();
+			key = KeyFrame();
+			bInKey = true;
+			bKeyOrientation = false;
+			while (p < lineEnd && isBlank(*p)) p++;
+			std::from_chars(p, lineEnd, key.frame);
+		}
+		else if (word == "Position:") {
+			parseVec3(p, lineEnd, bInKey ? key.position : joint->position);
+		}
+		else if (word == "Rotation:") {
+			parseVec3(p, lineEnd, bInKey ? key.rotation : joint->rotation);
+		}
+		else if (word == "Orientation:") {
+			if (bInKey) {
+				parseQuat(p, lineEnd, key.orientation);
+				bKeyOrientation = true;
+			}
+			else {
+				parseQuat(p, lineEnd, joint->orientation);
+				joint->bQuatRotation = true;
+			}
+		}
+		else if (word == "Scale:") {
+			parseVec3(p, lineEnd, bInKey ? key.scale : joint->scale);
+		}
+	}
+	finishKey();
+	return true;
+}
+
+bool readTextScene(const std::string &path, std::vector<SceneJoint> &joints, SceneReadStats *stats) {
+	auto start = std::chrono::steady_clock::now();
+
+	joints.clear();
+	MappedFile file;
+	if (!file.open(path)) {
+		std::cerr << "Failed to open file: " << path << std::endl;
+		return false;
+	}
+	const char *data = (const char *)file.data();
+	if (!parseTextScene(data, data + file.size(), joints)) return false;
+
+	if (stats) {
+		stats->bytes = file.size();
+		stats->joints = joints.size();
+		stats->keys = 0;
+		for (const auto &joint : joints) stats->keys += joint.keyFrames.size();
+		stats->seconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+	}
+	return true;
+}
+
+//--------------------------------------------------------------
+// binary format
+//
+static void copy3(float *dst, const glm::vec3 &v) { dst[0] = v.x; dst[1] = v.y; dst[2] = v.z; }
+static void copy4(float *dst, const glm::quat &q) { dst[0] = q.x; dst[1] = q.y; dst[2] = q.z; dst[3] = q.w; }
+
+bool writeAnimFile(const std::string &path, const std::vector<SceneJoint> &joints) {
+	std::ofstream file(path, std::ios::binary);
+	if (!file.is_open()) {
+		std::cerr << "File could not be opened for saving: " << path << std::endl;
+		return false;
+	}
+
+	std::vector<AnimJointEntry> entries(joints.size());
+	std::vector<AnimKeyRecord> keys;
+	std::string names;
+	int frameBegin = 0, frameEnd = 0;
+	bool bKeys = false;
+
+	for (size_t i = 0; i < joints.size(); i++) {
+		const SceneJoint &joint = joints[i];
+		AnimJointEntry &e = entries[i];
+		memset(&e, 0, sizeof(e));
+		e.parent = joint.parent;
+		e.nameOffset = (uint32_t)names.size();
+		e.nameLength = (uint32_t)joint.name.size();
+		e.flags = (joint.bQuatRotation ? ANIM_JOINT_QUAT : 0);
+		copy3(e.position, joint.position);
+		copy3(e.rotation, joint.rotation);
+		copy4(e.orientation, joint.orientation);
+		copy3(e.scale, joint.scale);
+		e.firstKey = (uint32_t)keys.size();
+		e.keyCount = (uint32_t)joint.keyFrames.size();
+		names += joint.name;
+
+		keys.resize(e.firstKey + e.keyCount);
+		if (e.keyCount) memcpy(&keys[e.firstKey], joint.keyFrames.data(), e.keyCount * sizeof(AnimKeyRecord));
+		for (const auto &kf : joint.keyFrames) {
+			frameBegin = (bKeys ? std::min(frameBegin, kf.frame) : kf.frame);
+			frameEnd = (bKeys ? std::max(frameEnd, kf.frame) : kf.frame);
+			bKeys = true;
+		}
+	}
+
+	AnimFileHeader header;
+	memcpy(header.magic, "HANM", 4);
+	header.version = ANIM_FILE_VERSION;
+	header.jointCount = (uint32_t)entries.size();
+	header.keyCount = (uint32_t)keys.size();
+	header.jointsOffset = sizeof(AnimFileHeader);
+	header.keysOffset = header.jointsOffset + (uint32_t)(entries.size() * sizeof(AnimJointEntry));
+	header.namesOffset = header.keysOffset + (uint32_t)(keys.size() * sizeof(AnimKeyRecord));
+	header.namesSize = (uint32_t)names.size();
+	header.frameBegin = frameBegin;
+	header.frameEnd = frameEnd;
+
+	file.write((const char *)&header, sizeof(header));
+	file.write((const char *)entries.data(), entries.size() * sizeof(AnimJointEntry));
+	file.write((const char *)keys.data(), keys.size() * sizeof(AnimKeyRecord));
+	file.write(names.data(), names.size());
+	return file.good();
+}
+
+bool MappedFile::open(const std::string &path) {
+	close();
+#ifdef _WIN32
+	HANDLE f = CreateFileA(path.c_str(), GENERIC_READ, FILE_SHARE_READ, NULL, OPEN_EXISTING, FILE_ATTRIBUTE_NORMAL, NULL);
+	if (f == INVALID_HANDLE_VALUE) return false;
+	LARGE_INTEGER fileSize;
+	if (!GetFileSizeEx(f, &fileSize) || fileSize.QuadPart == 0) {
+		CloseHandle(f);
+		return false;
+	}
+	HANDLE m = CreateFileMappingA(f, NULL, PAGE_READONLY, 0, 0, NULL);
+	if (m == NULL) {
+		CloseHandle(f);
+		return false;
+	}
+	void *view = MapViewOfFile(m, FILE_MAP_READ, 0, 0, 0);
+	if (view == NULL) {
+		CloseHandle(m);
+		CloseHandle(f);
+		return false;
+	}
+	fileHandle = f;
+	mapHandle = m;
+	base = (const uint8_t *)view;
+	length = (size_t)fileSize.QuadPart;
+#else
+	int fd = ::open(path.c_str(), O_RDONLY);
+	if (fd < 0) return false;
+	struct stat st;
+	if (fstat(fd, &st) != 0 || st.st_size == 0) {
+		::close(fd);
+		return false;
+	}
+	void *view = mmap(NULL, (size_t)st.st_size, PROT_READ, MAP_PRIVATE, fd, 0);
+	::close(fd);     // the mapping keeps the file open
+	if (view == MAP_FAILED) return false;
+	base = (const uint8_t *)view;
+	length = (size_t)st.st_size;
+#endif
+	return true;
+}
+
+void MappedFile::close() {
+	if (base == NULL) return;
+#ifdef _WIN32
+	UnmapViewOfFile(base);
+	CloseHandle(mapHandle);
+	CloseHandle(fileHandle);
+	mapHandle = fileHandle = NULL;
+#else
+	munmap((void *)base, length);
+#endif
+	base = NULL;
+	length = 0;
+}
+
+bool AnimFile::open(const std::string &path) {
+	error.clear();
+	if (!file.open(path)) {
+		error = "Failed to open file: " + path;
+		return false;
+	}
+
+	// validate everything once here, so the accessors can trust the offsets
+	//
+	const AnimFileHeader &h = header();
+	uint64_t size = file.size();
+	bool bValid = size >= sizeof(AnimFileHeader) && memcmp(h.magic, "HANM", 4) == 0;
+	if (bValid && h.version != ANIM_FILE_VERSION) {
+		error = "Unsupported animation file version " + std::to_string(h.version) + ": " + path;
+		file.close();
+		return false;
+	}
+	bValid = bValid &&
+		h.jointsOffset % 4 == 0 && h.keysOffset % 4 == 0 &&
+		(uint64_t)h.jointsOffset + (uint64_t)h.jointCount * sizeof(AnimJointEntry) <= size &&
+		(uint64_t)h.keysOffset + (uint64_t)h.keyCount * sizeof(AnimKeyRecord) <= size &&
+		(uint64_t)h.namesOffset + h.namesSize <= size;
+
+	for (uint32_t i = 0; bValid && i < h.jointCount; i++) {
+		const AnimJointEntry &e = joints()[i];
+		bValid = e.parent < (int32_t)i &&
+			(uint64_t)e.nameOffset + e.nameLength <= h.namesSize &&
+			(uint64_t)e.firstKey + e.keyCount <= h.keyCount;
+
+		// keys are used as they are, and the segment lookup assumes them sorted
+		//
+		const AnimKeyRecord *k = keys() + e.firstKey;
+		for (uint32_t j = 1; bValid && j < e.keyCount; j++) {
+			bValid = k[j - 1].frame < k[j].frame;
+		}
+	}
+	if (!bValid) {
+		error = "Not a valid animation file: " + path;
+		file.close();
+		return false;
+	}
+	return true;
+}
+
+std::string AnimFile::name(int joint) const {
+	const AnimJointEntry &e = joints()[joint];
+	const char *names = (const char *)(file.data() + header().namesOffset);
+	return std::string(names + e.nameOffset, e.nameLength);
+}
+
+void AnimFile::copyKeys(int joint, std::vector<KeyFrame> &keyFrames) const {
+	const AnimJointEntry &e = joints()[joint];
+	const KeyFrame *first = (const KeyFrame *)(keys() + e.firstKey);
+	keyFrames.assign(first, first + e.keyCount);
+}
+
+bool readAnimFile(const std::string &path, std::vector<SceneJoint> &joints) {
+	joints.clear();
+	AnimFile anim;
+	if (!anim.open(path)) {
+		std::cerr << anim.error << std::endl;
+		return false;
+	}
+
+	const AnimJointEntry *entries = anim.joints();
+	joints.resize(anim.header().jointCount);
+	for (int i = 0; i < (int)joints.size(); i++) {
+		const AnimJointEntry &e = entries[i];
+		SceneJoint &joint = joints[i];
+		joint.name = anim.name(i);
+		joint.parent = e.parent;
+		joint.position = glm::vec3(e.position[0], e.position[1], e.position[2]);
+		joint.rotation = glm::vec3(e.rotation[0], e.rotation[1], e.rotation[2]);
+		joint.orientation = glm::quat(e.orientation[3], e.orientation[0], e.orientation[1], e.orientation[2]);
+		joint.scale = glm::vec3(e.scale[0], e.scale[1], e.scale[2]);
+		joint.bQuatRotation = (e.flags & ANIM_JOINT_QUAT) != 0;
+		anim.copyKeys(i, joint.keyFrames);
+	}
+	return true;
+}
@@ -0,0 +1,161 @@
+//
+//  SceneIO.h - reading and writing joint hierarchies with their keyframes
+//
+//  Two formats are supported:
+//
+//    text   (.txt)   - the original human readable "Joint:/Parent:/KeyFrames:" format,
+//                      kept for import/export.
+//    binary (.hanim) - versioned, 4-byte aligned, little-endian layout designed to be
+//                      memory mapped and used in place (see AnimFile below).
+//
+#pragma once
+
+#include <string>
+#include <vector>
+#include <cstdint>
+#include "glm/glm.hpp"
+#include "glm/gtc/quaternion.hpp"
+#include "KeyFrame.h"
+
+// plain description of one joint, independent of the scene classes.
+//
+struct SceneJoint {
+	std::string name;
+	int parent = -1;     // index of the parent in the same list (parents come first), -1 => root
+	glm::vec3 position = glm::vec3(0, 0, 0);
+	glm::vec3 rotation = glm::vec3(0, 0, 0);
+	glm::quat orientation = glm::quat(1, 0, 0, 0);
+	glm::vec3 scale = glm::vec3(1, 1, 1);
+	bool bQuatRotation = false;
+	std::vector<KeyFrame> keyFrames;
+};
+
+bool writeTextScene(const std::string &path, const std::vector<SceneJoint> &joints);
+bool writeAnimFile(const std::string &path, const std::vector<SceneJoint> &joints);
+
+// timing of the last text read, for checking the parser on large exports
+//
+struct SceneReadStats {
+	size_t bytes = 0;
+	size_t joints = 0;
+	size_t keys = 0;
+	double seconds = 0;
+
+	double mbPerSecond() const { return (seconds > 0 ? bytes / (1024.0 * 1024.0) / seconds : 0); }
+	double keysPerSecond() const { return (seconds > 0 ? keys / seconds : 0); }
+};
+
+// Read a text scene.  The file is mapped and tokenized in a single pass, numbers
+// are parsed with std::from_chars.  Keys of each joint come out sorted by frame
+// (a repeated frame replaces the earlier key, like Joint::setKey()).  A Parent:
+// that is not an earlier joint (unknown, the joint itself or a later one) is
+// reported and the joint loaded as a root, as files edited by hand used to load.
+//
+bool readTextScene(const std::string &path, std::vector<SceneJoint> &joints, SceneReadStats *stats = NULL);
+bool parseTextScene(const char *begin, const char *end, std::vector<SceneJoint> &joints);
+
+// true if path names a binary animation file (by extension)
+//
+bool isAnimFilePath(const std::string &path);
+
+
+//  Binary layout (version 1):
+//
+//    AnimFileHeader
+//    AnimJointEntry[jointCount]     parents before children
+//    AnimKeyRecord[keyCount]        keys of joint i are [firstKey, firstKey + keyCount)
+//    char names[namesSize]          joint names, not null terminated
+//
+struct AnimFileHeader {
+	char magic[4];            // "HANM"
+	uint32_t version;
+	uint32_t jointCount;
+	uint32_t keyCount;
+	uint32_t jointsOffset;
+	uint32_t keysOffset;
+	uint32_t namesOffset;
+	uint32_t namesSize;
+	int32_t frameBegin;       // keyed frame range of the whole scene
+	int32_t frameEnd;
+};
+
+struct AnimJointEntry {
+	int32_t parent;
+	uint32_t nameOffset;
+	uint32_t nameLength;
+	uint32_t flags;           // ANIM_JOINT_QUAT
+	float position[3];
+	float rotation[3];
+	float orientation[4];     // x, y, z, w
+	float scale[3];
+	uint32_t firstKey;
+	uint32_t keyCount;
+};
+
+// same layout as KeyFrame (checked in SceneIO.cpp), so the keys of a joint
+// are copied to and from the file as one block
+//
+struct AnimKeyRecord {
+	int32_t frame;
+	float position[3];
+	float rotation[3];
+	float orientation[4];     // x, y, z, w
+	float scale[3];
+};
+
+const uint32_t ANIM_FILE_VERSION = 1;
+const uint32_t ANIM_JOINT_QUAT = 1;
+
+// read-only memory mapping of a whole file
+//
+class MappedFile {
+public:
+	MappedFile() {}
+	~MappedFile() { close(); }
+	MappedFile(const MappedFile &) = delete;
+	MappedFile &operator=(const MappedFile &) = delete;
+
+	bool open(const std::string &path);
+	void close();
+
+	const uint8_t *data() const { return base; }
+	size_t size() const { return length; }
+
+private:
+	const uint8_t *base = NULL;
+	size_t length = 0;
+#ifdef _WIN32
+	void *fileHandle = NULL;
+	void *mapHandle = NULL;
+#endif
+};
+
+// binary animation file, used in place: all accessors point into the mapping.
+//
+class AnimFile {
+public:
+	// map and validate the file.  returns false (with a message in error)
+	// if it can't be opened or is not a valid version 1 file.
+	//
+	bool open(const std::string &path);
+	void close() { file.close(); }
+
+	const AnimFileHeader &header() const { return *(const AnimFileHeader *)file.data(); }
+	const AnimJointEntry *joints() const { return (const AnimJointEntry *)(file.data() + header().jointsOffset); }
+	const AnimKeyRecord *keys() const { return (const AnimKeyRecord *)(file.data() + header().keysOffset); }
+	std::string name(int joint) const;
+
+	// replace keyFrames with the keys of a joint
+	//
+	void copyKeys(int joint, std::vector<KeyFrame> &keyFrames) const;
+
+	std::string error;
+
+private:
+	MappedFile file;
+};
+
+// Read a binary animation file into joints, like readTextScene() (the app
+// builds its joints straight from an AnimFile instead).
+//
+bool readAnimFile(const std::string &path, std::vector<SceneJoint> &joints);
@@ -0,0 +1,70 @@
+//
+//  SelectionSet.h - the selected scene objects
+//
+//  Membership is one bit per arena slot (pool and slot of the SceneHandle), so
+//  contains() is a shift and a mask however many objects are selected; the
+//  handles are also kept in a dense list in selection order, the first one
+//  being the primary selection.
+//
+//  A bit says nothing about the handle's generation: erase() an object before
+//  it is destroyed, and clear() the set together with the arena.
+//
+#pragma once
+
+#include <cstdint>
+#include <vector>
+#include <algorithm>
+#include "SceneArena.h"
+
+class SelectionSet {
+public:
+	bool contains(const SceneHandle &h) const {
+		if (h.isNull()) return false;
+		uint32_t pool = h.index >> SceneArena::SLOT_BITS;
+		uint32_t slot = h.index & SceneArena::SLOT_MASK;
+		if (pool >= bits.size() || (slot >> 6) >= bits[pool].size()) return false;
+		return ((bits[pool][slot >> 6] >> (slot & 63)) & 1) != 0;
+	}
+
+	// returns false if h is null or already selected
+	//
+	bool insert(const SceneHandle &h) {
+		if (h.isNull() || contains(h)) return false;
+		uint32_t pool = h.index >> SceneArena::SLOT_BITS;
+		uint32_t slot = h.index & SceneArena::SLOT_MASK;
+		if (pool >= bits.size()) bits.resize(pool + 1);
+		if ((slot >> 6) >= bits[pool].size()) bits[pool].resize((slot >> 6) + 1, 0);
+		bits[pool][slot >> 6] |= (uint64_t)1 << (slot & 63);
+		list.push_back(h);
+		return true;
+	}
+
+	// keeps the order of the others (linear in the selection size)
+	//
+	bool erase(const SceneHandle &h) {
+		if (!contains(h)) return false;
+		uint32_t slot = h.index & SceneArena::SLOT_MASK;
+		bits[h.index >> SceneArena::SLOT_BITS][slot >> 6] &= ~((uint64_t)1 << (slot & 63));
+		list.erase(std::find(list.begin(), list.end(), h));
+		return true;
+	}
+
+	// only the words of selected objects are touched
+	//
+	void clear() {
+		for (const SceneHandle &h : list) {
+			uint32_t slot = h.index & SceneArena::SLOT_MASK;
+			bits[h.index >> SceneArena::SLOT_BITS][slot >> 6] = 0;
+		}
+		list.clear();
+	}
+
+	const std::vector<SceneHandle> &handles() const { return list; }
+	SceneHandle primary() const { return (list.empty() ? SceneHandle() : list[0]); }
+	bool empty() const { return list.empty(); }
+	int size() const { return (int)list.size(); }
+
+private:
+	std::vector<std::vector<uint64_t>> bits;     // [pool][slot / 64]
+	std::vector<SceneHandle> list;               // selection order
+};
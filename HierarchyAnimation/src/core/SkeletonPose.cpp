@@ -0,0 +1,117 @@
+//
+//  SkeletonPose.cpp - flattened (structure of arrays) pose buffer for the scene hierarchy
+//
+
+#include "SkeletonPose.h"
+#include "PoseKernels.h"
+#include "JobSystem.h"
+#include "SceneGraph.h"
+
+// Flatten the hierarchy.  Each root is emitted followed by its subtree in depth-first
+// order, so parents always precede their children and every subtree occupies
+// a contiguous range of the arrays.
+//
+void SkeletonPose::build(const std::vector<SceneObject *> &scene) {
+	translation.clear();
+	rotation.clear();
+	scale.clear();
+	pivot.clear();
+	parent.clear();
+	groupBegin.clear();
+	objects.clear();
+	slot.clear();
+
+	for (auto obj : scene) {
+		if (obj->parent != NULL) continue;
+		if (groupBegin.empty() || size() - groupBegin.back() >= GROUP_SIZE) groupBegin.push_back(size());
+		addSubtree(obj, -1);
+	}
+
+	int n = size();
+	if (groupBegin.empty() || groupBegin.back() != n) groupBegin.push_back(n);
+	translation.resize(n);
+	rotation.resize(n);
+	scale.resize(n);
+	pivot.resize(n);
+	local.resize(n);
+	world.resize(n);
+	pull();
+}
+
+void SkeletonPose::addSubtree(SceneObject *obj, int parentIndex) {
+	int index = (int)objects.size();
+	objects.push_back(obj);
+	parent.push_back(parentIndex);
+	slot[obj] = index;
+	for (auto child : obj->childList) {
+		addSubtree(child, index);
+	}
+}
+
+int SkeletonPose::indexOf(const SceneObject *obj) const {
+	auto it = slot.find(obj);
+	return (it == slot.end() ? -1 : it->second);
+}
+
+void SkeletonPose::pull() {
+	pull(0, size());
+}
+
+void SkeletonPose::pull(int begin, int end) {
+	for (int i = begin; i < end; i++) {
+		SceneObject *obj = objects[i];
+		translation[i] = obj->position;
+		rotation[i] = obj->getRotationQuat();
+		scale[i] = obj->scale;
+		pivot[i] = obj->pivot;
+	}
+}
+
+// Same result as SceneObject::getMatrix(), i.e. parent * (trans * post * rotate * pre * scale),
+// but the local matrices are built directly from the channels by a batch
+// kernel (see PoseKernels.h) instead of from five separate matrix products.
+//
+void SkeletonPose::computeWorld() {
+	computeWorld(translation.data(), rotation.data(), scale.data(), local.data(), world.data(), true);
+}
+
+// local matrices are independent, world matrices only depend on joints of
+// the same root subtree.  Both stages are split into fixed ranges.
+//
+void SkeletonPose::computeWorld(const glm::vec3 *translation, const glm::quat *rotation, const glm::vec3 *scale,
+	glm::mat4 *local, glm::mat4 *world, bool bParallel) const {
+
+	if (empty()) return;
+	const PoseKernel &kernel = poseKernel();
+	const glm::vec3 *pivot = this->pivot.data();
+	const int *parent = this->parent.data();
+	const int *groupBegin = this->groupBegin.data();
+
+	auto buildLocal = [&](int begin, int end) {
+		kernel.buildLocal(translation + begin, rotation + begin, scale + begin, pivot + begin, local + begin, end - begin);
+	};
+	auto concat = [&](int begin, int end) {
+		for (int g = begin; g < end; g++) {
+			kernel.concat(local, parent, world, groupBegin[g], groupBegin[g + 1]);
+		}
+	};
+
+	int groups = (int)this->groupBegin.size() - 1;
+	if (bParallel) {
+		JobSystem &jobs = jobSystem();
+		jobs.parallelFor(size(), LOCAL_CHUNK, buildLocal);
+		jobs.parallelFor(groups, 1, concat);
+	}
+	else {
+		for (int begin = 0; begin < size(); begin += LOCAL_CHUNK) {
+			buildLocal(begin, std::min(begin + (int)LOCAL_CHUNK, size()));
+		}
+		concat(0, groups);
+	}
+}
+
+void SkeletonPose::push() {
+	for (int i = 0; i < size(); i++) {
+		objects[i]->setWorldMatrix(world[i]);
+	}
+}
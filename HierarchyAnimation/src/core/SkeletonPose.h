@@ -0,0 +1,96 @@
+//
+//  SkeletonPose.h - flattened (structure of arrays) pose buffer for the scene hierarchy
+//
+//  The SceneObject/Joint pointer tree stays the editing front-end.  For playback and
+//  drawing the hierarchy is flattened into contiguous arrays ordered so that every
+//  parent comes before its children; all world matrices are then produced by one
+//  linear pass over the arrays.
+//
+//  Every root subtree occupies a contiguous range, so independent rigs are
+//  evaluated in parallel (see JobSystem.h): local matrices in fixed chunks of
+//  joints, world matrices in groups of whole root subtrees.
+//
+#pragma once
+
+#include <vector>
+#include <unordered_map>
+#include "glm/glm.hpp"
+#include "glm/gtc/quaternion.hpp"
+
+class SceneObject;
+
+class SkeletonPose {
+public:
+
+	// rebuild the joint ordering from the scene hierarchy.
+	// must be called after objects are added, deleted or re-parented.
+	//
+	void build(const std::vector<SceneObject *> &scene);
+
+	// copy transform channels from the scene objects into the arrays
+	// (all of them, or slots [begin, end))
+	//
+	void pull();
+	void pull(int begin, int end);
+
+	// end of the subtree rooted at slot: the subtree is [slot, subtreeEnd(slot))
+	//
+	int subtreeEnd(int slot) const {
+		int end = slot + 1;
+		while (end < size() && parent[end] >= slot) end++;
+		return end;
+	}
+
+	// compute every world matrix in a single pass (parents before children)
+	//
+	void computeWorld();
+
+	// same, from channels other than the pose's own (e.g. a baked frame).
+	// The work is always split the same way, serial or parallel, so the
+	// result does not depend on the number of threads.
+	//
+	void computeWorld(const glm::vec3 *translation, const glm::quat *rotation, const glm::vec3 *scale,
+		glm::mat4 *local, glm::mat4 *world, bool bParallel) const;
+
+	// hand the computed world matrices back to the scene objects' caches
+	//
+	void push();
+
+	int size() const { return (int)parent.size(); }
+	bool empty() const { return parent.empty(); }
+
+	// index of obj in the arrays, -1 if it is not part of the pose
+	//
+	int indexOf(const SceneObject *obj) const;
+
+	// local channels
+	//
+	std::vector<glm::vec3> translation;
+	std::vector<glm::quat> rotation;
+	std::vector<glm::vec3> scale;
+	std::vector<glm::vec3> pivot;
+
+	// parent index for each joint (-1 => root).  parent[i] < i always holds.
+	//
+	std::vector<int> parent;
+
+	// root subtrees merged into groups of at least GROUP_SIZE joints.
+	// group k is [groupBegin[k], groupBegin[k + 1]); the last entry is size().
+	//
+	std::vector<int> groupBegin;
+	enum { LOCAL_CHUNK = 256, GROUP_SIZE = 256 };   // LOCAL_CHUNK is a multiple of the SIMD width
+
+	// output of computeWorld()
+	//
+	std::vector<glm::mat4> local;
+	std::vector<glm::mat4> world;
+
+	// scene object for each slot (same order as the arrays)
+	//
+	std::vector<SceneObject *> objects;
+
+private:
+	void addSubtree(SceneObject *obj, int parentIndex);
+
+	std::unordered_map<const SceneObject *, int> slot;
+};
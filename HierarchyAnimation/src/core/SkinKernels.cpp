@@ -0,0 +1,324 @@
+//
+//  SkinKernels.cpp - batch skinning kernels for SkinnedMesh
+//
+
+#include "SkinKernels.h"
+#include "KernelDispatch.h"
+#include "glm/gtc/quaternion.hpp"
+#include <cstring>
+#include <cmath>
+
+static_assert(sizeof(glm::mat4) == 16 * sizeof(float), "unexpected glm::mat4 layout");
+static_assert(sizeof(glm::vec3) == 3 * sizeof(float), "unexpected glm::vec3 layout");
+static_assert(sizeof(SkinDualQuat) == 8 * sizeof(float), "unexpected SkinDualQuat layout");
+
+
+//--------------------------------------------------------------
+//
+SkinDualQuat toDualQuat(const glm::mat4 &m) {
+
+	// orthonormalize the upper 3x3 so scaled joints still give a unit rotation
+	//
+	glm::vec3 x = glm::normalize(glm::vec3(m[0]));
+	glm::vec3 y = glm::vec3(m[1]);
+	y = glm::normalize(y - x * glm::dot(x, y));
+	glm::quat q = glm::quat_cast(glm::mat3(x, y, glm::cross(x, y)));
+
+	glm::vec3 r(q.x, q.y, q.z);
+	glm::vec3 t(m[3]);
+	SkinDualQuat dq;
+	dq.real = glm::vec4(r, q.w);
+	dq.dual = glm::vec4(q.w * t + glm::cross(t, r), -glm::dot(t, r)) * 0.5f;
+	return dq;
+}
+
+
+//--------------------------------------------------------------
+// scalar reference
+//
+
+static void linearScalar(const glm::mat4 *palette, const glm::vec3 *position, const glm::vec3 *normal,
+	const uint16_t *bone, const float *weight, float *outPosition, float *outNormal, int begin, int end) {
+
+	for (int v = begin; v < end; v++) {
+		const uint16_t *b = bone + 4 * v;
+		const float *w = weight + 4 * v;
+		glm::mat4 m = palette[b[0]] * w[0] + palette[b[1]] * w[1] + palette[b[2]] * w[2] + palette[b[3]] * w[3];
+
+		glm::vec3 p = m * glm::vec4(position[v], 1);
+		glm::vec3 n = glm::mat3(m) * normal[v];
+		float len = glm::length(n);
+		if (len > 0) n /= len;
+
+		float *op = outPosition + 3 * v;
+		float *on = outNormal + 3 * v;
+		op[0] = p.x; op[1] = p.y; op[2] = p.z;
+		on[0] = n.x; on[1] = n.y; on[2] = n.z;
+	}
+}
+
+// v rotated by the unit quaternion q
+//
+static inline glm::vec3 rotate(const glm::vec4 &q, const glm::vec3 &v) {
+	glm::vec3 r(q);
+	return v + glm::cross(r, glm::cross(r, v) + q.w * v) * 2.0f;
+}
+
+static void dualQuatScalar(const SkinDualQuat *palette, const glm::vec3 *position, const glm::vec3 *normal,
+	const uint16_t *bone, const float *weight, float *outPosition, float *outNormal, int begin, int end) {
+
+	for (int v = begin; v < end; v++) {
+		const uint16_t *b = bone + 4 * v;
+		const float *w = weight + 4 * v;
+
+		// q and -q are the same rotation; blend every bone on the side of the
+		// first one so the blend takes the short way
+		//
+		const glm::vec4 &first = palette[b[0]].real;
+		glm::vec4 real(0), dual(0);
+		for (int j = 0; j < 4; j++) {
+			const SkinDualQuat &dq = palette[b[j]];
+			float wj = (glm::dot(dq.real, first) < 0 ? -w[j] : w[j]);
+			real += dq.real * wj;
+			dual += dq.dual * wj;
+		}
+		float len = glm::length(real);
+		if (len > 0) {
+			real /= len;
+			dual /= len;
+		}
+
+		glm::vec3 r(real), d(dual);
+		glm::vec3 p = rotate(real, position[v]) + (d * real.w - r * dual.w + glm::cross(r, d)) * 2.0f;
+		glm::vec3 n = rotate(real, normal[v]);
+
+		float *op = outPosition + 3 * v;
+		float *on = outNormal + 3 * v;
+		op[0] = p.x; op[1] = p.y; op[2] = p.z;
+		on[0] = n.x; on[1] = n.y; on[2] = n.z;
+	}
+}
+
+static const SkinKernel scalarKernel = { "scalar", linearScalar, dualQuatScalar };
+
+
+#ifdef KERNELS_X86
+
+//--------------------------------------------------------------
+// SSE
+//
+
+// store x, y, z only; the 4th lane would overwrite the next vertex, which may
+// belong to a chunk written by another thread
+//
+static inline void store3(float *p, __m128 v) {
+	_mm_storel_pi((__m64 *)p, v);
+	_mm_store_ss(p + 2, _mm_movehl_ps(v, v));
+}
+
+// sum of the 4 lanes, in every lane
+//
+static inline __m128 sum4(__m128 d) {
+	d = _mm_add_ps(d, _mm_shuffle_ps(d, d, _MM_SHUFFLE(2, 3, 0, 1)));
+	return _mm_add_ps(d, _mm_shuffle_ps(d, d, _MM_SHUFFLE(1, 0, 3, 2)));
+}
+
+// normalize x, y, z (lane 3 must be 0); a zero vector stays zero
+//
+static inline __m128 normalize3(__m128 n) {
+	__m128 len = _mm_sqrt_ps(sum4(_mm_mul_ps(n, n)));
+	return _mm_and_ps(_mm_div_ps(n, len), _mm_cmpgt_ps(len, _mm_setzero_ps()));
+}
+
+// cross product of the x, y, z lanes; lane 3 is a.w b.w - a.w b.w = 0
+//
+static inline __m128 cross3(__m128 a, __m128 b) {
+	__m128 c = _mm_sub_ps(_mm_mul_ps(a, _mm_shuffle_ps(b, b, _MM_SHUFFLE(3, 0, 2, 1))),
+		_mm_mul_ps(_mm_shuffle_ps(a, a, _MM_SHUFFLE(3, 0, 2, 1)), b));
+	return _mm_shuffle_ps(c, c, _MM_SHUFFLE(3, 0, 2, 1));
+}
+
+static inline __m128 splatW(__m128 v) {
+	return _mm_shuffle_ps(v, v, _MM_SHUFFLE(3, 3, 3, 3));
+}
+
+// sign bit set in every lane if the 4 lane dot product of a and b is negative
+//
+static inline __m128 negativeDot(__m128 a, __m128 b) {
+	return _mm_and_ps(_mm_cmplt_ps(sum4(_mm_mul_ps(a, b)), _mm_setzero_ps()), _mm_set1_ps(-0.0f));
+}
+
+// normalize the blended dual quaternion (real, dual) and apply it to one
+// vertex: p' = p + 2 r x (r x p + w p) + 2 (w d - d.w r + r x d)
+//
+static inline void dualQuatVertex(__m128 real, __m128 dual, const glm::vec3 &p, const glm::vec3 &n, float *outPosition, float *outNormal) {
+	__m128 len = _mm_sqrt_ps(sum4(_mm_mul_ps(real, real)));
+	__m128 scale = _mm_and_ps(_mm_div_ps(_mm_set1_ps(1.0f), len), _mm_cmpgt_ps(len, _mm_setzero_ps()));
+	real = _mm_mul_ps(real, scale);
+	dual = _mm_mul_ps(dual, scale);
+
+	__m128 w = splatW(real);
+	__m128 two = _mm_set1_ps(2.0f);
+	__m128 vp = _mm_setr_ps(p.x, p.y, p.z, 0);
+	__m128 vn = _mm_setr_ps(n.x, n.y, n.z, 0);
+	__m128 rp = cross3(real, _mm_add_ps(cross3(real, vp), _mm_mul_ps(w, vp)));
+	__m128 rn = cross3(real, _mm_add_ps(cross3(real, vn), _mm_mul_ps(w, vn)));
+	__m128 t = _mm_add_ps(_mm_sub_ps(_mm_mul_ps(w, dual), _mm_mul_ps(splatW(dual), real)), cross3(real, dual));
+
+	store3(outPosition, _mm_add_ps(vp, _mm_mul_ps(two, _mm_add_ps(rp, t))));
+	store3(outNormal, _mm_add_ps(vn, _mm_mul_ps(two, rn)));
+}
+
+// one vertex per iteration: the blended matrix is built a column at a time
+// (one register per column), then applied to the position and normal
+//
+static void linearSSE(const glm::mat4 *palette, const glm::vec3 *position, const glm::vec3 *normal,
+	const uint16_t *bone, const float *weight, float *outPosition, float *outNormal, int begin, int end) {
+
+	for (int v = begin; v < end; v++) {
+		const uint16_t *b = bone + 4 * v;
+		const float *w = weight + 4 * v;
+
+		const float *P = &palette[b[0]][0][0];
+		__m128 wj = _mm_set1_ps(w[0]);
+		__m128 c0 = _mm_mul_ps(_mm_loadu_ps(P), wj);
+		__m128 c1 = _mm_mul_ps(_mm_loadu_ps(P + 4), wj);
+		__m128 c2 = _mm_mul_ps(_mm_loadu_ps(P + 8), wj);
+		__m128 c3 = _mm_mul_ps(_mm_loadu_ps(P + 12), wj);
+		for (int j = 1; j < 4; j++) {
+			P = &palette[b[j]][0][0];
+			wj = _mm_set1_ps(w[j]);
+			c0 = _mm_add_ps(c0, _mm_mul_ps(_mm_loadu_ps(P), wj));
+			c1 = _mm_add_ps(c1, _mm_mul_ps(_mm_loadu_ps(P + 4), wj));
+			c2 = _mm_add_ps(c2, _mm_mul_ps(_mm_loadu_ps(P + 8), wj));
+			c3 = _mm_add_ps(c3, _mm_mul_ps(_mm_loadu_ps(P + 12), wj));
+		}
+
+		const glm::vec3 &p = position[v];
+		const glm::vec3 &n = normal[v];
+		__m128 op = _mm_add_ps(_mm_add_ps(_mm_mul_ps(c0, _mm_set1_ps(p.x)), _mm_mul_ps(c1, _mm_set1_ps(p.y))),
+			_mm_add_ps(_mm_mul_ps(c2, _mm_set1_ps(p.z)), c3));
+		__m128 on = _mm_add_ps(_mm_add_ps(_mm_mul_ps(c0, _mm_set1_ps(n.x)), _mm_mul_ps(c1, _mm_set1_ps(n.y))),
+			_mm_mul_ps(c2, _mm_set1_ps(n.z)));
+
+		store3(outPosition + 3 * v, op);
+		store3(outNormal + 3 * v, normalize3(on));
+	}
+}
+
+// one vertex per iteration, real and dual part in one register each; the
+// hemisphere test is done with masks, no branches
+//
+static void dualQuatSSE(const SkinDualQuat *palette, const glm::vec3 *position, const glm::vec3 *normal,
+	const uint16_t *bone, const float *weight, float *outPosition, float *outNormal, int begin, int end) {
+
+	for (int v = begin; v < end; v++) {
+		const uint16_t *b = bone + 4 * v;
+		const float *w = weight + 4 * v;
+
+		const float *Q = &palette[b[0]].real[0];
+		__m128 first = _mm_loadu_ps(Q);
+		__m128 wj = _mm_set1_ps(w[0]);
+		__m128 real = _mm_mul_ps(first, wj);
+		__m128 dual = _mm_mul_ps(_mm_loadu_ps(Q + 4), wj);
+		for (int j = 1; j < 4; j++) {
+			Q = &palette[b[j]].real[0];
+			__m128 qr = _mm_loadu_ps(Q);
+			wj = _mm_xor_ps(_mm_set1_ps(w[j]), negativeDot(qr, first));
+			real = _mm_add_ps(real, _mm_mul_ps(qr, wj));
+			dual = _mm_add_ps(dual, _mm_mul_ps(_mm_loadu_ps(Q + 4), wj));
+		}
+		dualQuatVertex(real, dual, position[v], normal[v], outPosition + 3 * v, outNormal + 3 * v);
+	}
+}
+
+static const SkinKernel sseKernel = { "sse", linearSSE, dualQuatSSE };
+
+
+//--------------------------------------------------------------
+// AVX2 + FMA
+//
+
+// two columns per register: (c0 | c1) and (c2 | c3).  The position is
+// (c0 x + c1 y) + (c2 z + c3), i.e. the sum of the two halves of
+// (c0 | c1) * (x | y) + (c2 | c3) * (z | 1).
+//
+KERNEL_TARGET_AVX2
+static inline __m256 pair(float lo, float hi) {
+	return _mm256_insertf128_ps(_mm256_castps128_ps256(_mm_set1_ps(lo)), _mm_set1_ps(hi), 1);
+}
+
+KERNEL_TARGET_AVX2
+static void linearAVX2(const glm::mat4 *palette, const glm::vec3 *position, const glm::vec3 *normal,
+	const uint16_t *bone, const float *weight, float *outPosition, float *outNormal, int begin, int end) {
+
+	for (int v = begin; v < end; v++) {
+		const uint16_t *b = bone + 4 * v;
+		const float *w = weight + 4 * v;
+
+		const float *P = &palette[b[0]][0][0];
+		__m256 wj = _mm256_set1_ps(w[0]);
+		__m256 c01 = _mm256_mul_ps(_mm256_loadu_ps(P), wj);
+		__m256 c23 = _mm256_mul_ps(_mm256_loadu_ps(P + 8), wj);
+		for (int j = 1; j < 4; j++) {
+			P = &palette[b[j]][0][0];
+			wj = _mm256_set1_ps(w[j]);
+			c01 = _mm256_fmadd_ps(_mm256_loadu_ps(P), wj, c01);
+			c23 = _mm256_fmadd_ps(_mm256_loadu_ps(P + 8), wj, c23);
+		}
+
+		const glm::vec3 &p = position[v];
+		const glm::vec3 &n = normal[v];
+		__m256 tp = _mm256_fmadd_ps(c23, pair(p.z, 1.0f), _mm256_mul_ps(c01, pair(p.x, p.y)));
+		__m256 tn = _mm256_fmadd_ps(c23, pair(n.z, 0.0f), _mm256_mul_ps(c01, pair(n.x, n.y)));
+		__m128 op = _mm_add_ps(_mm256_castps256_ps128(tp), _mm256_extractf128_ps(tp, 1));
+		__m128 on = _mm_add_ps(_mm256_castps256_ps128(tn), _mm256_extractf128_ps(tn, 1));
+
+		store3(outPosition + 3 * v, op);
+		store3(outNormal + 3 * v, normalize3(on));
+	}
+}
+
+// a whole dual quaternion per register: (real | dual)
+//
+KERNEL_TARGET_AVX2
+static void dualQuatAVX2(const SkinDualQuat *palette, const glm::vec3 *position, const glm::vec3 *normal,
+	const uint16_t *bone, const float *weight, float *outPosition, float *outNormal, int begin, int end) {
+
+	for (int v = begin; v < end; v++) {
+		const uint16_t *b = bone + 4 * v;
+		const float *w = weight + 4 * v;
+
+		__m256 q = _mm256_loadu_ps(&palette[b[0]].real[0]);
+		__m128 first = _mm256_castps256_ps128(q);
+		__m256 blend = _mm256_mul_ps(q, _mm256_set1_ps(w[0]));
+		for (int j = 1; j < 4; j++) {
+			q = _mm256_loadu_ps(&palette[b[j]].real[0]);
+			__m128 sign = negativeDot(_mm256_castps256_ps128(q), first);
+			__m256 wj = _mm256_xor_ps(_mm256_set1_ps(w[j]), _mm256_insertf128_ps(_mm256_castps128_ps256(sign), sign, 1));
+			blend = _mm256_fmadd_ps(q, wj, blend);
+		}
+		dualQuatVertex(_mm256_castps256_ps128(blend), _mm256_extractf128_ps(blend, 1), position[v], normal[v],
+			outPosition + 3 * v, outNormal + 3 * v);
+	}
+}
+
+static const SkinKernel avx2Kernel = { "avx2", linearAVX2, dualQuatAVX2 };
+
+#endif // KERNELS_X86
+
+
+//--------------------------------------------------------------
+//
+static const SkinKernel *const kernels[KERNEL_LEVELS] = {
+	&scalarKernel, KERNEL_X86(&sseKernel), KERNEL_X86(&avx2Kernel)
+};
+
+const SkinKernel *skinKernelByName(const char *name) {
+	return kernelByName(kernels, name);
+}
+
+const SkinKernel &skinKernel() {
+	static const SkinKernel &best = bestKernel(kernels);
+	return best;
+}
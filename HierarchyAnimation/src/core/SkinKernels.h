@@ -0,0 +1,51 @@
+//
+//  SkinKernels.h - batch skinning kernels for SkinnedMesh
+//
+//  Every vertex has 4 bone influences (bone indices into the palette, weights that
+//  sum to 1).  linear() blends the 4 palette matrices and transforms the bind pose
+//  position and normal with the result (linear blend skinning).  dualQuat()
+//  blends the bones' dual quaternions instead (dual quaternion skinning): no
+//  volume loss at twisted or strongly bent joints, but rigid transforms only.
+//
+//  Scalar, SSE and AVX2 versions; see KernelDispatch.h for how one is picked.
+//
+#pragma once
+
+#include <cstdint>
+#include "glm/glm.hpp"
+
+//  packed unit dual quaternion of a rigid transform, 8 floats:
+//  rotation (x y z w) and translation part (x y z w), dual = 0.5 * t * real
+//
+struct SkinDualQuat {
+	glm::vec4 real;
+	glm::vec4 dual;
+};
+
+// rotation and translation of m (scale and shear are dropped)
+//
+SkinDualQuat toDualQuat(const glm::mat4 &m);
+
+struct SkinKernel {
+	const char *name;
+
+	// vertices [begin, end).  bone and weight hold 4 entries per vertex;
+	// outPosition and outNormal 3 floats per vertex (normals are renormalized).
+	//
+	void (*linear)(const glm::mat4 *palette, const glm::vec3 *position, const glm::vec3 *normal,
+		const uint16_t *bone, const float *weight, float *outPosition, float *outNormal, int begin, int end);
+
+	// same with one dual quaternion per bone
+	//
+	void (*dualQuat)(const SkinDualQuat *palette, const glm::vec3 *position, const glm::vec3 *normal,
+		const uint16_t *bone, const float *weight, float *outPosition, float *outNormal, int begin, int end);
+};
+
+// best kernel for this CPU (selected once, on first use)
+//
+const SkinKernel &skinKernel();
+
+// look up a kernel by name ("scalar", "sse", "avx2").
+// returns NULL if it is not compiled in or not supported by this CPU.
+//
+const SkinKernel *skinKernelByName(const char *name);
@@ -0,0 +1,244 @@
+//
+//  SkinnedMesh.cpp - triangle mesh bound to skeleton joints
+//
+
+#include "SkinnedMesh.h"
+#include "JobSystem.h"
+#include <fstream>
+#include <sstream>
+#include <iostream>
+
+static const int SKIN_CHUNK = 1024;      // vertices per job
+
+void SkinnedMesh::clear() {
+	positions.clear();
+	normals.clear();
+	bones.clear();
+	weights.clear();
+	indices.clear();
+	boneNames.clear();
+}
+
+bool SkinnedMesh::validate(std::string &error) {
+	size_t count = positions.size();
+	if (normals.size() != count || bones.size() != 4 * count || weights.size() != 4 * count) {
+		error = "vertex arrays have different sizes";
+		return false;
+	}
+	if (boneNames.empty() || boneNames.size() > 65536) {
+		error = "a mesh needs 1 to 65536 bones";
+		return false;
+	}
+	if (indices.size() % 3 != 0) {
+		error = "triangle list is incomplete";
+		return false;
+	}
+	for (uint32_t i : indices) {
+		if (i >= count) {
+			error = "triangle index " + std::to_string(i) + " out of range";
+			return false;
+		}
+	}
+	for (size_t v = 0; v < count; v++) {
+		float sum = 0;
+		for (int k = 0; k < 4; k++) {
+			if (bones[4 * v + k] >= boneNames.size()) {
+				error = "vertex " + std::to_string(v) + " references bone " + std::to_string(bones[4 * v + k]);
+				return false;
+			}
+			sum += weights[4 * v + k];
+		}
+
+		// unweighted vertices follow the first bone
+		//
+		if (sum <= 0) {
+			weights[4 * v] = 1;
+			continue;
+		}
+		for (int k = 0; k < 4; k++) weights[4 * v + k] /= sum;
+	}
+	return true;
+}
+
+//--------------------------------------------------------------
+//
+void SkinPalette::reset(int boneCount) {
+	inverseBind.assign(boneCount, glm::mat4(1.0));
+	matrix.assign(boneCount, glm::mat4(1.0));
+	dualQuat.assign(boneCount, toDualQuat(glm::mat4(1.0)));
+	version.assign(boneCount, 0);
+	bSet.assign(boneCount, 0);
+	moved.clear();
+	builtMode = -1;
+}
+
+void SkinPalette::bind(int bone, const glm::mat4 &world) {
+	inverseBind[bone] = glm::inverse(world);
+	bSet[bone] = 0;
+}
+
+void SkinPalette::set(int bone, const glm::mat4 &world, unsigned int worldVersion) {
+	if (bSet[bone] && version[bone] == worldVersion) return;
+	version[bone] = worldVersion;
+	bSet[bone] = 1;
+	matrix[bone] = world * inverseBind[bone];
+	moved.push_back(bone);
+}
+
+int SkinPalette::build(SkinMode mode) {
+
+	// the matrices are kept current by set(); dual quaternions are converted
+	// in one pass over the bones that moved
+	//
+	int count = (int)moved.size();
+	if (mode != builtMode) {
+		count = size();
+		if (mode == SKIN_DUAL_QUAT) {
+			for (int i = 0; i < count; i++) dualQuat[i] = toDualQuat(matrix[i]);
+		}
+	}
+	else if (mode == SKIN_DUAL_QUAT) {
+		for (int bone : moved) dualQuat[bone] = toDualQuat(matrix[bone]);
+	}
+	moved.clear();
+	builtMode = mode;
+	return count;
+}
+
+//--------------------------------------------------------------
+// text format
+//
+
+// next line that is not empty or a comment
+//
+static bool nextLine(std::istream &in, std::istringstream &line) {
+	std::string text;
+	while (std::getline(in, text)) {
+		size_t first = text.find_first_not_of(" \t\r");
+		if (first == std::string::npos || text[first] == '#') continue;
+		line.clear();
+		line.str(text);
+		return true;
+	}
+	return false;
+}
+
+// "<section> N" header
+//
+static bool readCount(std::istream &in, const char *section, size_t &count) {
+	std::istringstream line;
+	std::string word;
+	return (nextLine(in, line) && (line >> word >> count) && word == section);
+}
+
+bool readSkinFile(const std::string &path, SkinnedMesh &mesh, std::string &error) {
+	mesh.clear();
+	std::ifstream file(path);
+	if (!file.is_open()) {
+		error = "Failed to open file: " + path;
+		return false;
+	}
+
+	std::istringstream line;
+	size_t count;
+	if (!readCount(file, "bones", count)) {
+		error = "Expected \"bones N\": " + path;
+		return false;
+	}
+	mesh.boneNames.resize(count);
+	for (auto &name : mesh.boneNames) {
+		if (!nextLine(file, line) || !(line >> name)) {
+			error = "Missing bone names: " + path;
+			return false;
+		}
+	}
+
+	if (!readCount(file, "vertices", count)) {
+		error = "Expected \"vertices N\": " + path;
+		return false;
+	}
+	mesh.positions.resize(count);
+	mesh.normals.resize(count);
+	mesh.bones.resize(4 * count);
+	mesh.weights.resize(4 * count);
+	for (size_t v = 0; v < count; v++) {
+		glm::vec3 &p = mesh.positions[v];
+		glm::vec3 &n = mesh.normals[v];
+		uint16_t *b = &mesh.bones[4 * v];
+		float *w = &mesh.weights[4 * v];
+		if (!nextLine(file, line) || !(line >> p.x >> p.y >> p.z >> n.x >> n.y >> n.z >> b[0] >> b[1] >> b[2] >> b[3] >> w[0] >> w[1] >> w[2] >> w[3])) {
+			error = "Bad vertex " + std::to_string(v) + ": " + path;
+			return false;
+		}
+	}
+
+	if (!readCount(file, "triangles", count)) {
+		error = "Expected \"triangles N\": " + path;
+		return false;
+	}
+	mesh.indices.resize(3 * count);
+	for (size_t t = 0; t < count; t++) {
+		uint32_t *i = &mesh.indices[3 * t];
+		if (!nextLine(file, line) || !(line >> i[0] >> i[1] >> i[2])) {
+			error = "Bad triangle " + std::to_string(t) + ": " + path;
+			return false;
+		}
+	}
+
+	if (!mesh.validate(error)) {
+		error += ": " + path;
+		return false;
+	}
+	return true;
+}
+
+bool writeSkinFile(const std::string &path, const SkinnedMesh &mesh) {
+	std::ofstream file(path);
+	if (!file.is_open()) {
+		std::cerr << "File could not be opened for saving: " << path << std::endl;
+		return false;
+	}
+
+	file << "# skinned mesh (see SkinnedMesh.h)" << std::endl;
+	file << "bones " << mesh.boneNames.size() << std::endl;
+	for (const auto &name : mesh.boneNames) file << name << std::endl;
+
+	file << "vertices " << mesh.positions.size() << std::endl;
+	for (size_t v = 0; v < mesh.positions.size(); v++) {
+		const glm::vec3 &p = mesh.positions[v];
+		const glm::vec3 &n = mesh.normals[v];
+		const uint16_t *b = &mesh.bones[4 * v];
+		const float *w = &mesh.weights[4 * v];
+		file << p.x << " " << p.y << " " << p.z << "  " << n.x << " " << n.y << " " << n.z << "  "
+			<< b[0] << " " << b[1] << " " << b[2] << " " << b[3] << "  "
+			<< w[0] << " " << w[1] << " " << w[2] << " " << w[3] << std::endl;
+	}
+
+	file << "triangles " << mesh.indices.size() / 3 << std::endl;
+	for (size_t t = 0; t + 2 < mesh.indices.size(); t += 3) {
+		file << mesh.indices[t] << " " << mesh.indices[t + 1] << " " << mesh.indices[t + 2] << std::endl;
+	}
+	return file.good();
+}
+
+//--------------------------------------------------------------
+//
+void skinLinear(const SkinnedMesh &mesh, const glm::mat4 *palette, float *outPosition, float *outNormal, bool bParallel) {
+	const SkinKernel &kernel = skinKernel();
+	auto body = [&](int begin, int end) {
+		kernel.linear(palette, mesh.positions.data(), mesh.normals.data(), mesh.bones.data(), mesh.weights.data(),
+			outPosition, outNormal, begin, end);
+	};
+	if (bParallel) jobSystem().parallelFor(mesh.vertexCount(), SKIN_CHUNK, body);
+	else body(0, mesh.vertexCount());
+}
+
+void skinDualQuat(const SkinnedMesh &mesh, const SkinDualQuat *palette, float *outPosition, float *outNormal, bool bParallel) {
+	const SkinKernel &kernel = skinKernel();
+	auto body = [&](int begin, int end) {
+		kernel.dualQuat(palette, mesh.positions.data(), mesh.normals.data(), mesh.bones.data(), mesh.weights.data(),
+			outPosition, outNormal, begin, end);
+	};
+	if (bParallel) jobSystem().parallelFor(mesh.vertexCount(), SKIN_CHUNK, body);
+	else body(0, mesh.vertexCount());
+}
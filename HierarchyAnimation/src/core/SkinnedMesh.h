@@ -0,0 +1,90 @@
+//
+//  SkinnedMesh.h - triangle mesh bound to skeleton joints
+//
+//  The bind pose is stored in world space together with 4 bone influences per
+//  vertex.  Bones are referenced by joint name; the app binds them to its joints
+//  and builds the palette:
+//
+//    palette[i] = world matrix of bone i  *  inverse(world matrix of bone i at bind time)
+//
+//  SkinPalette keeps that palette per mesh and only rebuilds the entries of bones
+//  that moved.  skinLinear() then deforms every vertex with the blended palette
+//  matrices (linear blend skinning), skinDualQuat() with the blended dual
+//  quaternions (see SkinKernels.h); both are split over the job system.
+//
+//  Text format (.skin), whitespace separated, '#' starts a comment line:
+//
+//    bones N        followed by N joint names
+//    vertices N     followed by N lines  px py pz  nx ny nz  b0 b1 b2 b3  w0 w1 w2 w3
+//    triangles N    followed by N lines  i0 i1 i2
+//
+#pragma once
+
+#include <string>
+#include <vector>
+#include <cstdint>
+#include "glm/glm.hpp"
+#include "SkinKernels.h"
+
+struct SkinnedMesh {
+	std::vector<glm::vec3> positions;     // bind pose
+	std::vector<glm::vec3> normals;
+	std::vector<uint16_t> bones;          // 4 per vertex, index into boneNames
+	std::vector<float> weights;           // 4 per vertex
+	std::vector<uint32_t> indices;        // 3 per triangle
+	std::vector<std::string> boneNames;
+
+	int vertexCount() const { return (int)positions.size(); }
+
+	// check sizes and indices and rescale the weights of every vertex to sum
+	// to 1.  returns false (and sets error) if the mesh can't be used.
+	//
+	bool validate(std::string &error);
+
+	void clear();
+};
+
+enum SkinMode {
+	SKIN_LINEAR,
+	SKIN_DUAL_QUAT,
+};
+
+//  per bone skinning transforms of one mesh, in the form the skinning mode
+//  needs: matrices for SKIN_LINEAR, packed dual quaternions for SKIN_DUAL_QUAT.
+//  set() is called every frame with each bone's joint matrix and the joint's
+//  SceneObject::worldVersion; build() then converts only the bones whose version
+//  changed (all of them after a mode change).
+//
+class SkinPalette {
+public:
+	void reset(int boneCount);                               // all bones identity
+	void bind(int bone, const glm::mat4 &world);             // bind pose of a bone
+	void set(int bone, const glm::mat4 &world, unsigned int version);
+
+	// returns the number of entries rebuilt; 0 => the skinned vertices of the
+	// last build are still valid
+	//
+	int build(SkinMode mode);
+
+	const glm::mat4 *matrices() const { return matrix.data(); }
+	const SkinDualQuat *dualQuats() const { return dualQuat.data(); }
+	int size() const { return (int)matrix.size(); }
+
+private:
+	std::vector<glm::mat4> inverseBind;
+	std::vector<glm::mat4> matrix;                 // world * inverseBind
+	std::vector<SkinDualQuat> dualQuat;
+	std::vector<unsigned int> version;
+	std::vector<unsigned char> bSet;               // version is valid
+	std::vector<int> moved;                        // bones to rebuild
+	int builtMode = -1;                            // mode of the last build, -1 => none
+};
+
+bool readSkinFile(const std::string &path, SkinnedMesh &mesh, std::string &error);
+bool writeSkinFile(const std::string &path, const SkinnedMesh &mesh);
+
+// deform the mesh with the given palette (one matrix per bone).  outPosition and
+// outNormal receive 3 floats per vertex and may point into a mapped vertex buffer.
+//
+void skinLinear(const SkinnedMesh &mesh, const glm::mat4 *palette, float *outPosition, float *outNormal, bool bParallel = true);
+void skinDualQuat(const SkinnedMesh &mesh, const SkinDualQuat *palette, float *outPosition, float *outNormal, bool bParallel = true);
@@ -0,0 +1,44 @@
+//
+//  TripleBuffer.h - lock-free single producer / single consumer triple buffer
+//
+//  The producer fills back() and publish()es it; the consumer calls update() and
+//  reads front().  Neither side ever waits: the producer always has a free slot to
+//  write into, and the consumer always sees the most recently published slot
+//  (older unread slots are simply overwritten).
+//
+#pragma once
+
+#include <atomic>
+
+template <class T>
+class TripleBuffer {
+public:
+
+	// producer side
+	//
+	T &back() { return slots[backIndex]; }
+
+	// make back() the latest slot and continue with the slot the consumer released
+	//
+	void publish() {
+		backIndex = middle.exchange(backIndex | FRESH, std::memory_order_acq_rel) & INDEX;
+	}
+
+	// consumer side.  returns true if a newer slot was published since the last call.
+	//
+	bool update() {
+		if (!(middle.load(std::memory_order_relaxed) & FRESH)) return false;
+		frontIndex = middle.exchange(frontIndex, std::memory_order_acq_rel) & INDEX;
+		return true;
+	}
+
+	const T &front() const { return slots[frontIndex]; }
+
+private:
+	enum { INDEX = 3, FRESH = 4 };
+
+	T slots[3];
+	std::atomic<int> middle{ 1 };    // slot index in between, | FRESH if not read yet
+	int backIndex = 0;               // owned by the producer
+	int frontIndex = 2;              // owned by the consumer
+};
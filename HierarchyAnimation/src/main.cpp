@@ -3,7 +3,14 @@
 
 //========================================================================
 int main( ){
-	ofSetupOpenGL(1200,800,OF_WINDOW);			// <-------- setup the GL context
+	// GL 3.2 context: SceneRenderer draws instanced with a buffer texture.
+	// Fixed-function lighting and wide lines are not available (see ofApp::setup()).
+	//
+	ofGLWindowSettings settings;
+	settings.setGLVersion(3, 2);
+	settings.setSize(1200, 800);
+	settings.windowMode = OF_WINDOW;
+	ofCreateWindow(settings);			// <-------- setup the GL context
 
 	// this kicks off the running of my app
 	// can be OF_WINDOW or OF_FULLSCREEN
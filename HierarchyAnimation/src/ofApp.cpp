@@ -30,9 +30,11 @@ void ofApp::setup() {
 	topCam.setNearClip(.1);
 	topCam.setPosition(0, 16, 0);
 	topCam.lookAt(glm::vec3(0, 0, 0));
-	ofSetSmoothLighting(true);
 
-	// setup one point light
+	// setup one point light.  With the GL 3.2 context (see main.cpp) there is no
+	// fixed-function lighting: objects drawn between material.begin() and end()
+	// are lit by the enabled ofLights in ofMaterial's shader, the instanced
+	// shapes by SceneRenderer's shader.
 	//
 	light1.enable();
 	light1.setPosition(5, 5, 0);
@@ -40,13 +42,19 @@ void ofApp::setup() {
 	light1.setSpecularColor(ofColor(255.f, 255.f, 255.f));
 
 	theCam = &mainCam;
+	renderer.setup();
+
+	// 'g' generates a crowd of humanoid rigs
+	//
+	genParams.shape = GEN_HUMANOID;
+	genParams.copies = 64;
 
 	//  create a scene consisting of a ground plane with 2x2 blocks
 	//  arranged in semi-random positions, scales and rotations
 	//
 	// ground plane
 	//
-	scene.push_back(new Plane(glm::vec3(0, -2, 0), glm::vec3(0, 1, 0)));
+	scene.create<Plane>(glm::vec3(0, -2, 0), glm::vec3(0, 1, 0));
 
 	/*Sphere* sun = new Sphere(glm::vec3(0,0,0), 3.0, ofColor::yellow);
 	Sphere* earth = new Sphere(glm::vec3(7,1,0), 1.0, ofColor::blue);
@@ -64,16 +72,27 @@ void ofApp::setup() {
 	gui.add(rotationText.setup("Rotation", "x: 0.0, y: 0.0, z: 0.0"));
 
 	setupKeyframeUI();
+
+	animWorker.setInterpolation(useEaseInterpolation, useSlerp);
+	animWorker.start();
+}
+
+//--------------------------------------------------------------
+void ofApp::exit() {
+	animWorker.stop();
 }
 
 
 //--------------------------------------------------------------
 void ofApp::update() {
+	profiler().endFrame();
+	PROFILE_SCOPE("update");
+
 	//scene[1]->rotation.y++;
 	//scene[2]->rotation.y++;
 	//scene[2]->scale += .1;
 	if (objSelected()) {
-		glm::vec3 rotation = selected[0]->rotation;
+		glm::vec3 rotation = selectedObject()->getEulerRotation();
 		rotationText =
 			"X: " + std::to_string(rotation.x) +
 			", Y: " + std::to_string(rotation.y) +
@@ -86,9 +105,20 @@ void ofApp::update() {
 	//if (bAnimate) {
 
 	//}
+
+	// objects were added, deleted or loaded: the worker gets a fresh copy
+	//
+	if (bPoseStale) {
+		pose.build(scene.objects());
+		culler.build(scene.objects());
+		bPoseStale = false;
+		animWorker.rebuild(pose, frameBegin, frameEnd);
+		showFrame();
+	}
+
 	if (bInPlayback) {
 		nextFrame();
-		interpolateKeyFrames();
+		showFrame();
 	}
 
 	// if keyframes are set and the current frame is between
@@ -117,33 +147,67 @@ void ofApp::update() {
 //--------------------------------------------------------------
 void ofApp::draw() {
 
+	{
+		PROFILE_SCOPE("applyPose");
+		applyLatestPose();
+	}
+
+	// deform skinned meshes with the latest pose
+	//
+	{
+		PROFILE_SCOPE("skin");
+		for (Mesh* mesh : scene.all<Mesh>()) {
+			mesh->skin(scene);
+		}
+	}
+
+	// skip every subtree outside the view of the active camera
+	//
+	{
+		PROFILE_SCOPE("cull");
+		culler.update();
+		culler.cull(Frustum(theCam->getModelViewProjectionMatrix()));
+		profiler().setCounter("culled", culler.culledCount());
+	}
+
+	int64_t sceneBegin = profiler().now();
 	theCam->begin();
 	ofNoFill();
 	drawAxis();
-	ofEnableLighting();
 
-	//  draw the objects in scene
+	//  draw the visible objects; objects with an instanced shape only add
+	//  themselves to the renderer here, everything else is drawn directly
 	//
 	material.begin();
 	ofFill();
-	for (int i = 0; i < scene.size(); i++) {
-		if (std::find(selected.begin(), selected.end(), scene[i]) != selected.end()) {
-			ofSetColor(ofColor::white);
-		}
-		else {
-			ofSetColor(scene[i]->diffuseColor);
-		}
-		scene[i]->draw();
+	renderer.begin();
+	for (auto obj : culler.visible()) {
+		obj->submit(renderer, selected.contains(obj->handle));
 	}
 
 	material.end();
-	ofDisableLighting();
+	renderer.draw(light1.getPosition());
+	drawHover();
 	ofDisableDepthTest();
 	theCam->end();
-	gui.draw();
+	profiler().record("draw scene", sceneBegin, profiler().now());
 
-	keyframePanel.draw();
-	drawTimeline();
+	if (bMarquee) {
+		ofNoFill();
+		ofSetColor(ofColor::yellow);
+		ofDrawRectangle(marqueeStart, marqueeEnd.x - marqueeStart.x, marqueeEnd.y - marqueeStart.y);
+		ofFill();
+	}
+
+	{
+		PROFILE_SCOPE("gui");
+		gui.draw();
+		keyframePanel.draw();
+	}
+	{
+		PROFILE_SCOPE("drawTimeline");
+		drawTimeline();
+	}
 
 	// Display the current frame and total frames
 	std::string str1;
@@ -157,29 +221,105 @@ void ofApp::draw() {
 	int xOffset = ofGetWidth() - 150;
 	int yOffset = 25;
 
-	for (auto& obj : selected) {
-		Joint* joint = dynamic_cast<Joint*>(obj);
-		if (joint) {
-			ofSetColor(ofColor::yellow);
-			ofDrawBitmapString("Joint: " + joint->name, xOffset, yOffset);
-			yOffset += 20;
-
-			ofSetColor(ofColor::lightGreen);
-			for (int i = 0; i < joint->keyFrames.size(); i++) {
-				const KeyFrame& kf = joint->keyFrames[i];
-				std::ostringstream buf;
-				buf << "Keyframe " << (i + 1) << ": ";
-				buf << "Frame: " << kf.frame << ", " << endl;
-				buf << "Position: (" << kf.position.x << ", " << kf.position.y << ", " << kf.position.z << "), ";
-				buf << "Rotation: (" << kf.rotation.x << ", " << kf.rotation.y << ", " << kf.rotation.z << "), ";
-				buf << "Scale: (" << kf.scale.x << ", " << kf.scale.y << ", " << kf.scale.z << ")";
-				ofDrawBitmapString(buf.str(), 5, yOffset + 30);
-				yOffset += 30;
-			}
+	for (Joint* joint : selectedJoints()) {
+		ofSetColor(ofColor::yellow);
+		ofDrawBitmapString("Joint: " + joint->name, xOffset, yOffset);
+		yOffset += 20;
+
+		ofSetColor(ofColor::lightGreen);
+		for (int i = 0; i < joint->keyFrames.size(); i++) {
+			const KeyFrame& kf = joint->keyFrames[i];
+			std::ostringstream buf;
+			buf << "Keyframe " << (i + 1) << ": ";
+			buf << "Frame: " << kf.frame << ", " << endl;
+			buf << "Position: (" << kf.position.x << ", " << kf.position.y << ", " << kf.position.z << "), ";
+			buf << "Rotation: (" << kf.rotation.x << ", " << kf.rotation.y << ", " << kf.rotation.z << "), ";
+			buf << "Scale: (" << kf.scale.x << ", " << kf.scale.y << ", " << kf.scale.z << ")";
+			ofDrawBitmapString(buf.str(), 5, yOffset + 30);
+			yOffset += 30;
 		}
 	}
 	ofSetColor(ofColor::white);
 
+	if (bShowProfiler) drawProfiler();
+}
+
+// stage timings (rolling average / p99 / last frame, ms), counters and a
+// histogram of the frame times in 2 ms buckets
+//
+void ofApp::drawProfiler() {
+	int x = 10;
+	int y = 420;
+	ofSetColor(ofColor::white);
+	ofDrawBitmapString("stage             avg     p99    last (ms)", x, y);
+	for (const auto& stats : profiler().stageStats()) {
+		y += 15;
+		char line[128];
+		snprintf(line, sizeof(line), "%-14s %6.2f  %6.2f  %6.2f", stats.name, stats.averageMs, stats.p99Ms, stats.lastMs);
+		ofDrawBitmapString(line, x, y);
+	}
+	for (const auto& counter : profiler().counters()) {
+		y += 15;
+		ofDrawBitmapString(string(counter.name) + ": " + ofToString(counter.value), x, y);
+	}
+
+	const int buckets = 25;
+	const float bucketMs = 2.0;
+	vector<float> frameTimes = profiler().frameTimes();
+	vector<int> counts(buckets, 0);
+	for (float ms : frameTimes) {
+		counts[std::min(buckets - 1, (int)(ms / bucketMs))]++;
+	}
+
+	y += 25;
+	ofDrawBitmapString("frame time, 0 - " + ofToString(buckets * bucketMs) + "+ ms", x, y);
+	int base = y + 65;
+	for (int i = 0; i < buckets; i++) {
+		float h = (frameTimes.empty() ? 0 : 60.0f * counts[i] / frameTimes.size());
+		ofSetColor(i * bucketMs < 17 ? ofColor::lightGreen : ofColor::orangeRed);
+		ofDrawRectangle(x + i * 12, base - h, 10, h);
+	}
+	ofSetColor(ofColor::white);
+}
+
+// write the last traceSeconds of profiler events to the data folder
+//
+void ofApp::saveTrace() {
+	string path = ofToDataPath("trace_" + ofGetTimestampString() + ".json", true);
+	if (profiler().writeChromeTrace(path, traceSeconds)) {
+		cout << "Trace written to " << path << endl;
+	}
+	else {
+		cerr << "Can't write trace " << path << endl;
+	}
+}
+
+// Copy the latest pose published by the animation worker into the scene.
+// Poses that do not include every edit sent so far are skipped; they would
+// undo the edit (e.g. snap a dragged joint back) until the worker catches up.
+//
+void ofApp::applyLatestPose() {
+	const PoseSnapshot* snapshot = animWorker.latest();
+	if (!snapshot || bPoseStale || snapshot->editCount != animWorker.editCount()) return;
+	if ((int)snapshot->world.size() != pose.size()) return;
+
+	// channels first: markDirty() invalidates the world matrices of the subtree
+	//
+	for (int i = 0; i < pose.size(); i++) {
+		if (!snapshot->animated[i]) continue;
+		SceneObject* obj = pose.objects[i];
+		obj->position = snapshot->position[i];
+		obj->rotation = snapshot->rotation[i];
+		obj->orientation = snapshot->orientation[i];
+		obj->scale = snapshot->scale[i];
+		obj->markDirty();
+	}
+	// unchanged matrices keep their worldVersion, so only what moved is
+	// refit, re-culled and re-skinned
+	//
+	for (int i = 0; i < pose.size(); i++) {
+		pose.objects[i]->setWorldMatrix(snapshot->world[i]);
+	}
 }
 
 void ofApp::setupKeyframeUI() {
@@ -193,6 +333,7 @@ void ofApp::setupKeyframeUI() {
 	loadBtn.setup("Load, l");
 	frameSlider.setup("Frame", frame, frameBegin, frameEnd);
 	useEaseInterpolation.setup("Use Ease Interpolation", false);
+	useSlerp.setup("Use Slerp (quaternion joints), q toggles", false);
 
 	keyframePanel.add(&addKeyframeBtn);
 	keyframePanel.add(&deleteKeyframeBtn);
@@ -202,6 +343,7 @@ void ofApp::setupKeyframeUI() {
 	keyframePanel.add(&loadBtn);
 	keyframePanel.add(&frameSlider);
 	keyframePanel.add(&useEaseInterpolation);
+	keyframePanel.add(&useSlerp);
 
 	// Setup event listeners
 	addKeyframeBtn.addListener(this, &ofApp::setKeyFrame);
@@ -211,6 +353,8 @@ void ofApp::setupKeyframeUI() {
 	saveBtn.addListener(this, &ofApp::saveToFile);
 	loadBtn.addListener(this, &ofApp::loadFile);
 	frameSlider.addListener(this, &ofApp::frameChanged);
+	useEaseInterpolation.addListener(this, &ofApp::interpolationChanged);
+	useSlerp.addListener(this, &ofApp::interpolationChanged);
 }
 
 
@@ -237,12 +381,12 @@ void ofApp::drawTimeline() {
 
 	// Draw keyframes for selected joint
 	if (objSelected()) {
-		Joint* selectedJoint = dynamic_cast<Joint*>(selected[0]);
-		if (selectedJoint) {
+		Joint* joint = selectedJoint();
+		if (joint) {
 			int mouseX = ofGetMouseX();
 			int mouseY = ofGetMouseY();
 
-			for (const auto& kf : selectedJoint->keyFrames) {
+			for (const auto& kf : joint->keyFrames) {
 				float x = ofMap(kf.frame, frameBegin, frameEnd, 10, timelineWidth + 10);
 
 				// Check if mouse is hovering over keyframe
@@ -283,7 +427,7 @@ void ofApp::handleTimelineClick(int x, int y) {
 
 void ofApp::frameChanged(int& f) {
 	frame = f;
-	interpolateKeyFrames();
+	showFrame();
 }
 
 // 
@@ -291,7 +435,8 @@ void ofApp::frameChanged(int& f) {
 //
 void ofApp::drawAxis(glm::mat4 m, float len) {
 
-	ofSetLineWidth(1.0);
+	// lines are 1 pixel wide (core profile contexts have no wide lines)
+	//
 
 	// X Axis
 	ofSetColor(ofColor(255, 0, 0));
@@ -311,32 +456,33 @@ void ofApp::drawAxis(glm::mat4 m, float len) {
 //
 void ofApp::printChannels(SceneObject* obj) {
 	cout << "position = glm::vec3(" << obj->position.x << "," << obj->position.y << "," << obj->position.z << ");" << endl;
-	cout << "rotation = glm::vec3(" << obj->rotation.x << "," << obj->rotation.y << "," << obj->rotation.z << ");" << endl;
+	glm::vec3 rotation = obj->getEulerRotation();
+	cout << "rotation = glm::vec3(" << rotation.x << "," << rotation.y << "," << rotation.z << ");" << endl;
 	cout << "scale = glm::vec3(" << obj->scale.x << "," << obj->scale.y << "," << obj->scale.z << ");" << endl;
 }
 
 void ofApp::addJoint() {
 	std::string jointName = "joint" + std::to_string(jointCounter);
 	jointCounter++;
-	Joint* newJoint = new Joint(jointName, 1.0f);
+	Joint* newJoint = scene.create<JointShape>(jointName, 1.0f);
 
 	// set parent
 	if (objSelected()) {
-		SceneObject* selectedObj = selected[0];
-		Joint* parentJoint = dynamic_cast<Joint*>(selectedObj);
+		Joint* parentJoint = selectedJoint();
 		if (parentJoint) {
 			parentJoint->addChild(newJoint);
 		}
 	}
 
-	scene.push_back(newJoint);
-	selected.clear();
-	selected.push_back(newJoint);
+	bPoseStale = true;
+	bPickStale = true;
+	clearSelectionList();
+	select(newJoint);
 }
 
 void ofApp::deleteObject() {
 	if (objSelected()) {
-		SceneObject* selectedObj = selected[0];
+		SceneObject* selectedObj = selectedObject();
 		// add children to the selected joint's parent
 		for (auto child : selectedObj->childList) {
 			if (selectedObj->parent) {
@@ -344,6 +490,7 @@ void ofApp::deleteObject() {
 			}
 			else {
 				child->parent = nullptr;
+				child->markWorldDirty();
 			}
 		}
 
@@ -353,184 +500,229 @@ void ofApp::deleteObject() {
 			siblings.erase(std::remove(siblings.begin(), siblings.end(), selectedObj), siblings.end());
 		}
 
-		// remove from scene
-		scene.erase(std::remove(scene.begin(), scene.end(), selectedObj), scene.end());
+		bPoseStale = true;
+		bPickStale = true;
 
-		// delete the joint
-		delete selectedObj;
-		selected.clear();
+		// remove from scene and delete the joint
+		clearSelectionList();
+		scene.destroy(selectedObj);
 	}
 }
 
+// gather all joints in parent-before-child order for the scene writers
+//
+void ofApp::collectJoints(vector<SceneJoint>& joints) {
+	std::function<void(SceneObject*, int)> add = [&](SceneObject* obj, int parentIndex) {
+		Joint* joint = scene.asJoint(obj);
+		if (!joint) return;
+
+		SceneJoint sceneJoint;
+		sceneJoint.name = joint->name;
+		sceneJoint.parent = parentIndex;
+		sceneJoint.position = joint->position;
+		sceneJoint.rotation = joint->getEulerRotation();
+		sceneJoint.orientation = joint->getRotationQuat();
+		sceneJoint.scale = joint->scale;
+		sceneJoint.bQuatRotation = joint->bQuatRotation;
+		sceneJoint.keyFrames = joint->keyFrames;
+
+		int index = joints.size();
+		joints.push_back(sceneJoint);
+		for (auto child : joint->childList) {
+			add(child, index);
+		}
+	};
+
+	for (Joint* joint : scene.joints()) {
+		if (joint->parent == NULL) add(joint, -1);
+	}
+}
+
+// files ending in .hanim are written in the binary format, anything else as text
+//
 void ofApp::saveToFile() {
 	ofFileDialogResult result = ofSystemSaveDialog("animation.txt", "Save");
 
 	if (result.bSuccess) {
 		std::string filePath = result.getPath();
 
-		std::ofstream file(filePath);
+		vector<SceneJoint> joints;
+		collectJoints(joints);
 
-		if (!file.is_open()) {
-			cerr << "File could not be opened for saving: " << filePath << endl;
-			return;
+		bool bSaved = (isAnimFilePath(filePath) ? writeAnimFile(filePath, joints) : writeTextScene(filePath, joints));
+		if (bSaved) {
+			cout << "Scene saved to file: " << filePath << endl;
 		}
-
-		for (auto& obj : scene) {
-			// check if the object is a joint
-			Joint* joint = dynamic_cast<Joint*>(obj);
-			if (joint) {
-				file << "Joint: " << joint->name << endl;
-				file << "Parent: " << (joint->parent ? joint->parent->name : "None") << endl; // Save parent name
-				file << "Position: (" << joint->position.x << ", " << joint->position.y << ", " << joint->position.z << ")" << endl;
-				file << "Rotation: (" << joint->rotation.x << ", " << joint->rotation.y << ", " << joint->rotation.z << ")" << endl;
-				file << "Scale: (" << joint->scale.x << ", " << joint->scale.y << ", " << joint->scale.z << ")" << endl;
-
-				// write keyframe data
-				if (!joint->keyFrames.empty()) {
-					file << "KeyFrames:" << endl;
-					for (const auto& kf : joint->keyFrames) {
-						file << "  Frame: " << kf.frame << endl;
-						file << "    Position: (" << kf.position.x << ", " << kf.position.y << ", " << kf.position.z << ")" << endl;
-						file << "    Rotation: (" << kf.rotation.x << ", " << kf.rotation.y << ", " << kf.rotation.z << ")" << endl;
-						file << "    Scale: (" << kf.scale.x << ", " << kf.scale.y << ", " << kf.scale.z << ")" << endl;
-					}
-				}
-				file << endl;
-			}
-		}
-
-		file.close();
-		cout << "Scene saved to file: " << filePath << endl;
 	}
 	else {
 		cout << "Save canceled." << endl;
 	}
 }
 
-void ofApp::loadFile() {
-	ofFileDialogResult result = ofSystemLoadDialog("Load");
+// Load a binary (.hanim) file.  The file is memory mapped and read in place;
+// joint records and key arrays are copied straight into the joints.
+//
+void ofApp::loadAnimFile(const string& filePath) {
+	AnimFile anim;
+	if (!anim.open(filePath)) {
+		cerr << anim.error << endl;
+		return;
+	}
 
-	if (result.bSuccess) {
-		string filePath = result.getPath();
-		std::ifstream file(filePath);
+	clearScene();
+
+	const AnimFileHeader& header = anim.header();
+	const AnimJointEntry* entries = anim.joints();
+	vector<Joint*> joints(header.jointCount);
+	for (uint32_t i = 0; i < header.jointCount; i++) {
+		const AnimJointEntry& e = entries[i];
+		Joint* joint = scene.create<JointShape>(anim.name(i), 1.0f);
+		joint->position = glm::vec3(e.position[0], e.position[1], e.position[2]);
+		joint->rotation = glm::vec3(e.rotation[0], e.rotation[1], e.rotation[2]);
+		joint->orientation = glm::quat(e.orientation[3], e.orientation[0], e.orientation[1], e.orientation[2]);
+		joint->scale = glm::vec3(e.scale[0], e.scale[1], e.scale[2]);
+		joint->bQuatRotation = (e.flags & ANIM_JOINT_QUAT) != 0;
+
+		// keys are stored sorted (open() checks it) and in KeyFrame layout,
+		// so they are copied as one block
+		//
+		anim.copyKeys(i, joint->keyFrames);
 
-		if (!file.is_open()) {
-			cerr << "Failed to open file: " << filePath << endl;
-			return;
-		}
+		if (e.parent >= 0) joints[e.parent]->addChild(joint);
+		joints[i] = joint;
+	}
 
-		scene.clear();
-		std::unordered_map<string, Joint*> joints;
-		Joint* currentJoint = nullptr;
+	loadFinished();
+}
 
-		string line;
-		while (std::getline(file, line)) {
-			std::istringstream stream(line);
-			string word;
-			stream >> word;
+// delete every object in the scene (all at once, see SceneArena::clear()).
+// The pose and the picking tree still point at the old objects; both are
+// rebuilt before they are used again.
+//
+void ofApp::clearScene() {
+	clearSelectionList();
+	scene.clear();
+	bPoseStale = true;
+	bPickStale = true;
+}
 
-			if (word == "Joint:") {
-				string jointName;
-				stream >> jointName;
+// common to all loaders: put every joint at its first key and
+// reset the playback range to the keyed frames
+//
+void ofApp::loadFinished() {
+	for (Joint* joint : scene.joints()) {
+		if (!joint->keyFrames.empty()) {
+			const KeyFrame& firstKeyFrame = joint->keyFrames.front();
+			joint->position = firstKeyFrame.position;
+			joint->rotation = firstKeyFrame.rotation;
+			joint->orientation = firstKeyFrame.orientation;
+			joint->scale = firstKeyFrame.scale;
+			joint->markDirty();
+		}
+	}
 
-				currentJoint = new Joint(jointName, 1.0f);
-				scene.push_back(currentJoint);
-				joints[jointName] = currentJoint;
-			}
-			else if (word == "Parent:" && currentJoint) {
-				string parentName;
-				stream >> parentName;
+	// Reset playback frame range
+	frame = frameBegin = 1;
+	frameEnd = 0;
+	for (Joint* joint : scene.joints()) {
+		if (!joint->keyFrames.empty()) {
+			frameEnd = std::max(frameEnd, joint->keyFrames.back().frame);
+		}
+	}
 
-				if (parentName != "None" && joints.find(parentName) != joints.end()) {
-					currentJoint->parent = joints[parentName];
-					joints[parentName]->addChild(currentJoint);
-				}
-			}
-			else if (word == "Position:" && currentJoint) {
-				char dummy;
-				glm::vec3 position;
-				stream >> dummy >> position.x >> dummy >> position.y >> dummy >> position.z >> dummy;
-				currentJoint->position = position;
-			}
-			else if (word == "Rotation:" && currentJoint) {
-				char dummy;
-				glm::vec3 rotation;
-				stream >> dummy >> rotation.x >> dummy >> rotation.y >> dummy >> rotation.z >> dummy;
-				currentJoint->rotation = rotation;
-			}
-			else if (word == "Scale:" && currentJoint) {
-				char dummy;
-				glm::vec3 scale;
-				stream >> dummy >> scale.x >> dummy >> scale.y >> dummy >> scale.z >> dummy;
-				currentJoint->scale = scale;
-			}
-			else if (word == "Frame:" && currentJoint) {
-				KeyFrame keyFrame;
-				stream >> keyFrame.frame;
-
-				while (std::getline(file, line) && line.find("Frame:") == std::string::npos && !line.empty()) {
-					std::istringstream subStream(line);
-					string subWord;
-					subStream >> subWord;
-
-					if (subWord == "Position:") {
-						char dummy;
-						glm::vec3 position;
-						subStream >> dummy >> position.x >> dummy >> position.y >> dummy >> position.z >> dummy;
-						keyFrame.position = position;
-					}
-					else if (subWord == "Rotation:") {
-						char dummy;
-						glm::vec3 rotation;
-						subStream >> dummy >> rotation.x >> dummy >> rotation.y >> dummy >> rotation.z >> dummy;
-						keyFrame.rotation = rotation;
-					}
-					else if (subWord == "Scale:") {
-						char dummy;
-						glm::vec3 scale;
-						subStream >> dummy >> scale.x >> dummy >> scale.y >> dummy >> scale.z >> dummy;
-						keyFrame.scale = scale;
-					}
-				}
+	bInPlayback = false;
+	cout << "Scene loaded successfully!" << endl;
+}
 
-				currentJoint->keyFrames.push_back(keyFrame);
+void ofApp::loadFile() {
+	ofFileDialogResult result = ofSystemLoadDialog("Load");
 
-				if (line.find("Frame:") != std::string::npos) {
-					std::istringstream frameStream(line);
-					frameStream >> word;
-					frameStream >> keyFrame.frame;
-				}
-			}
+	if (result.bSuccess) {
+		string filePath = result.getPath();
+		if (isAnimFilePath(filePath)) {
+			loadAnimFile(filePath);
+			return;
 		}
 
-		for (auto& obj : scene) {
-			Joint* joint = dynamic_cast<Joint*>(obj);
-			if (joint && !joint->keyFrames.empty()) {
-				const KeyFrame& firstKeyFrame = joint->keyFrames.front();
-				joint->position = firstKeyFrame.position;
-				joint->rotation = firstKeyFrame.rotation;
-				joint->scale = firstKeyFrame.scale;
-			}
-		}
+		vector<SceneJoint> joints;
+		SceneReadStats stats;
+		if (!readTextScene(filePath, joints, &stats)) return;
 
-		// Reset playback frame range
-		frame = frameBegin = 1;
-		frameEnd = 0;
-		for (auto& obj : scene) {
-			Joint* joint = dynamic_cast<Joint*>(obj);
-			if (joint && !joint->keyFrames.empty()) {
-				frameEnd = std::max(frameEnd, joint->keyFrames.back().frame);
-			}
-		}
+		cout << "Read " << stats.bytes / (1024.0 * 1024.0) << " MB, " << stats.joints << " joints, " << stats.keys << " keys in "
+			<< stats.seconds * 1000.0 << " ms (" << stats.mbPerSecond() << " MB/s, " << stats.keysPerSecond() << " keys/s)" << endl;
 
-		bInPlayback = false;
-		cout << "Scene loaded successfully!" << endl;
+		loadSceneJoints(joints);
 	}
 	else {
 		cout << "Load operation canceled." << endl;
 	}
 }
 
+// replace the scene with joints (parents before children)
+//
+void ofApp::loadSceneJoints(const vector<SceneJoint>& joints) {
+	clearScene();
+	vector<Joint*> created(joints.size());
+	for (size_t i = 0; i < joints.size(); i++) {
+		const SceneJoint& sceneJoint = joints[i];
+		Joint* joint = scene.create<JointShape>(sceneJoint.name, 1.0f);
+		joint->position = sceneJoint.position;
+		joint->rotation = sceneJoint.rotation;
+		joint->bQuatRotation = sceneJoint.bQuatRotation;
+		if (joint->bQuatRotation) joint->orientation = sceneJoint.orientation;
+		joint->scale = sceneJoint.scale;
+		joint->keyFrames = sceneJoint.keyFrames;
+
+		if (sceneJoint.parent >= 0) created[sceneJoint.parent]->addChild(joint);
+		created[i] = joint;
+	}
+
+	loadFinished();
+}
+
+// replace the scene with a synthetic one (see SceneGenerator.h)
+//
+void ofApp::generateTestScene() {
+	vector<SceneJoint> joints;
+	generateScene(genParams, joints);
+	cout << "Generated " << joints.size() << " joints" << endl;
+	loadSceneJoints(joints);
+
+	if (bGenerateSkin) {
+		SkinnedMesh skin;
+		generateSkin(joints, skin);
+		addMesh(skin);
+	}
+}
+
+// add a mesh bound to the joints of the scene (in their current pose)
+//
+Mesh* ofApp::addMesh(const SkinnedMesh& skin) {
+	Mesh* mesh = scene.create<Mesh>();
+	mesh->setSkin(skin);
+	mesh->setSkinMode(skinMode);
+	int bound = mesh->bind(scene.joints());
+	bPoseStale = true;
+	bPickStale = true;
+	cout << "Skin: " << skin.vertexCount() << " vertices, " << bound << " of " << skin.boneNames.size() << " bones bound" << endl;
+	return mesh;
+}
+
+// load a skin (.skin, see SkinnedMesh.h) for the joints in the scene
+//
+void ofApp::loadSkin() {
+	ofFileDialogResult result = ofSystemLoadDialog("Load skin");
+	if (!result.bSuccess) return;
+
+	SkinnedMesh skin;
+	string error;
+	if (!readSkinFile(result.getPath(), skin, error)) {
+		cerr << error << endl;
+		return;
+	}
+	addMesh(skin);
+}
+
 
 
 //--------------------------------------------------------------
@@ -590,6 +782,9 @@ void ofApp::keyPressed(int key) {
 	case 'f':
 		ofToggleFullscreen();
 		break;
+	case 'g':
+		generateTestScene();
+		break;
 	case 'h':
 		bHide = !bHide;
 		break;
@@ -604,10 +799,32 @@ void ofApp::keyPressed(int key) {
 	case 'l':
 		loadFile();
 		break;
+	case 'm':
+		loadSkin();
+		break;
 	case 'n':
 		break;
+	case 'o':
+		bShowProfiler = !bShowProfiler;
+		break;
+	case 't':
+		saveTrace();
+		break;
+	case 'w':
+		skinMode = (skinMode == SKIN_LINEAR ? SKIN_DUAL_QUAT : SKIN_LINEAR);
+		for (Mesh* mesh : scene.all<Mesh>()) {
+			mesh->setSkinMode(skinMode);
+		}
+		cout << "Skinning: " << (skinMode == SKIN_LINEAR ? "linear blend" : "dual quaternion") << endl;
+		break;
+	case 'q':
+		for (auto obj : selectedObjects()) {
+			obj->useQuatRotation(!obj->bQuatRotation);
+			channelsChanged(obj);
+		}
+		break;
 	case 'p':
-		if (objSelected()) printChannels(selected[0]);
+		if (objSelected()) printChannels(selectedObject());
 		break;
 	case 'r':
 		resetRotation();
@@ -653,33 +870,85 @@ void ofApp::keyPressed(int key) {
 }
 
 //--------------------------------------------------------------
+// hover: pick on every move (the inverse world matrices are cached, so this
+// is cheap enough to run per event)
+//
 void ofApp::mouseMoved(int x, int y) {
-
+	SceneObject* obj = NULL;
+	if (!isMouseOverTimeline(x, y) && !mainCam.getMouseInputEnabled()) obj = pickObject(x, y);
+	hovered = (obj ? obj->handle : SceneHandle());
 }
 
 //--------------------------------------------------------------
 void ofApp::mouseDragged(int x, int y, int button) {
+	if (bMarquee) {
+		marqueeEnd = glm::vec2(x, y);
+		return;
+	}
+	if (!bDrag) {
+		mouseMoved(x, y);
+		return;
+	}
 
 	if (objSelected() && bDrag) {
+		SceneObject* obj = selectedObject();
 		glm::vec3 point;
 		mouseToDragPlane(x, y, point);
 		if (bRotateX) {
-			selected[0]->rotation += glm::vec3((point.x - lastPoint.x) * 20.0, 0, 0);
+			obj->addRotation(glm::vec3((point.x - lastPoint.x) * 20.0, 0, 0));
 		}
 		else if (bRotateY) {
-			selected[0]->rotation += glm::vec3(0, (point.x - lastPoint.x) * 20.0, 0);
+			obj->addRotation(glm::vec3(0, (point.x - lastPoint.x) * 20.0, 0));
 		}
 		else if (bRotateZ) {
-			selected[0]->rotation += glm::vec3(0, 0, (point.x - lastPoint.x) * 20.0);
+			obj->addRotation(glm::vec3(0, 0, (point.x - lastPoint.x) * 20.0));
 		}
 		else {
-			selected[0]->position += (point - lastPoint);
+			obj->setLocalPosition(obj->position + (point - lastPoint));
 		}
 		lastPoint = point;
+		channelsChanged(obj);    // rest pose of the edited object changed
 	}
 
 }
 
+//  nearest selectable object under the mouse point, NULL if none.  The pick tree
+//  is refit at most once per frame, however many mouse events come in.
+//
+SceneObject* ofApp::pickObject(int x, int y) {
+	if (bPickStale) {
+		pickBVH.build(scene.objects());
+		bPickStale = false;
+		pickFrame = ofGetFrameNum() + 1;
+	}
+	else if (pickFrame != ofGetFrameNum() + 1) {
+		pickBVH.refit();
+		pickFrame = ofGetFrameNum() + 1;
+	}
+
+	glm::vec3 p = theCam->screenToWorld(glm::vec3(x, y, 0));
+	glm::vec3 dn = glm::normalize(p - theCam->getPosition());
+	float t;
+	return pickBVH.intersect(Ray(p, dn), t);
+}
+
+//  outline the local bounds of the object under the mouse
+//
+void ofApp::drawHover() {
+	SceneObject* obj = scene.get(hovered);
+	glm::vec3 boundsMin, boundsMax;
+	if (!obj || !obj->getLocalBounds(boundsMin, boundsMax)) return;
+
+	glm::vec3 size = boundsMax - boundsMin;
+	ofPushMatrix();
+	ofMultMatrix(obj->getMatrix());
+	ofNoFill();
+	ofSetColor(ofColor::yellow);
+	ofDrawBox((boundsMin + boundsMax) * 0.5f, size.x, size.y, size.z);
+	ofFill();
+	ofPopMatrix();
+}
+
 //  This projects the mouse point in screen space (x, y) to a 3D point on a plane
 //  normal to the view axis of the camera passing through the point of the selected object.
 //  If no object selected, the plane passing through the world origin is used.
@@ -692,7 +961,7 @@ bool ofApp::mouseToDragPlane(int x, int y, glm::vec3& point) {
 	float dist;
 	glm::vec3 pos;
 	if (objSelected()) {
-		pos = selected[0]->position;
+		pos = selectedObject()->position;
 	}
 	else pos = glm::vec3(0, 0, 0);
 	if (glm::intersectRayPlane(p, dn, pos, glm::normalize(theCam->getZAxis()), dist)) {
@@ -711,18 +980,18 @@ void ofApp::mousePressed(int x, int y, int button) {
 	if (isMouseOverTimeline(x, y)) {
 		// Check if we're clicking near any keyframe markers
 		if (objSelected()) {
-			Joint* selectedJoint = dynamic_cast<Joint*>(selected[0]);
-			if (selectedJoint) {
-				for (auto& kf : selectedJoint->keyFrames) {
+			Joint* joint = selectedJoint();
+			if (joint) {
+				for (auto& kf : joint->keyFrames) {
 					float kfX = ofMap(kf.frame, frameBegin, frameEnd, 10, timelineWidth + 10);
 					float dist = glm::distance(glm::vec2(x, y), glm::vec2(kfX, timelineY + timelineHeight / 2));
 
 					if (dist < keyframeMarkerSize) {
 						// Right click to delete keyframe
 						if (button == OF_MOUSE_BUTTON_RIGHT) {
-							auto it = std::remove_if(selectedJoint->keyFrames.begin(), selectedJoint->keyFrames.end(),
-								[&](const KeyFrame& k) { return k.frame == kf.frame; });
-							selectedJoint->keyFrames.erase(it, selectedJoint->keyFrames.end());
+							int keyFrame = kf.frame;
+							joint->deleteKey(keyFrame);
+							keysChanged(joint, keyFrame);
 							return;
 						}
 						// Left click to select frame
@@ -745,61 +1014,64 @@ void ofApp::mousePressed(int x, int y, int button) {
 	// clear selection list
 	//
 	if (!bCtrlKeyDown) {
-		for (SceneObject* obj : selected) {
-			obj->isSelected = false;
-		}
-		selected.clear();
+		clearSelectionList();
 	}
 
 	//
 	// test if something selected
 	//
-	vector<SceneObject*> hits;
+	SceneObject* selectedObj = pickObject(x, y);
 
-	glm::vec3 p = theCam->screenToWorld(glm::vec3(x, y, 0));
-	glm::vec3 d = p - theCam->getPosition();
-	glm::vec3 dn = glm::normalize(d);
-
-	// check for selection of scene objects
-	//
-	for (int i = 0; i < scene.size(); i++) {
-
-		glm::vec3 point, norm;
-
-		//  We hit an object
-		//
-		if (scene[i]->isSelectable && scene[i]->intersect(Ray(p, dn), point, norm)) {
-			hits.push_back(scene[i]);
-		}
+	if (selectedObj && !selected.contains(selectedObj->handle)) {
+		select(selectedObj);
+		bDrag = true;
+		mouseToDragPlane(x, y, lastPoint);
 	}
 
-
-	// if we selected more than one, pick nearest
+	// nothing hit: start a marquee
 	//
-	SceneObject* selectedObj = NULL;
-	if (hits.size() > 0) {
-		selectedObj = hits[0];
-		float nearestDist = std::numeric_limits<float>::infinity();
-		for (int n = 0; n < hits.size(); n++) {
-			float dist = glm::length(hits[n]->position - theCam->getPosition());
-			if (dist < nearestDist) {
-				nearestDist = dist;
-				selectedObj = hits[n];
-			}
-		}
-	}
-	if (selectedObj && std::find(selected.begin(), selected.end(), selectedObj) == selected.end()) {
-		selected.push_back(selectedObj);
-		selectedObj->isSelected = true;
-		bDrag = true;
-		mouseToDragPlane(x, y, lastPoint);
+	else if (!selectedObj) {
+		bMarquee = true;
+		marqueeStart = marqueeEnd = glm::vec2(x, y);
 	}
 }
 
 //--------------------------------------------------------------
 void ofApp::mouseReleased(int x, int y, int button) {
 	bDrag = false;
+	if (bMarquee) {
+		bMarquee = false;
+		marqueeEnd = glm::vec2(x, y);
+		glm::vec2 size = glm::abs(marqueeEnd - marqueeStart);
+		if (size.x > 2 && size.y > 2) selectInRect(marqueeStart, marqueeEnd);
+	}
+}
+
+//  select every selectable object whose origin projects into the rectangle
+//  (window coordinates).  Instead of projecting each point, the rectangle is
+//  turned into a frustum (see Frustum::fromRect()) and all positions are tested
+//  against it, a packet of BOX_PACKET at a time.
+//
+void ofApp::selectInRect(const glm::vec2& corner0, const glm::vec2& corner1) {
+	PROFILE_SCOPE("marquee");
+	ofRectangle viewport = ofGetCurrentViewport();
+	Frustum frustum = Frustum::fromRect(theCam->getModelViewProjectionMatrix(),
+		glm::vec4(viewport.x, viewport.y, viewport.width, viewport.height), corner0, corner1);
+
+	marqueeObjects.clear();
+	for (auto obj : scene.objects()) {
+		if (obj->isSelectable) marqueeObjects.push_back(obj);
+	}
+	marqueePoints.resize((int)marqueeObjects.size());
+	for (int i = 0; i < (int)marqueeObjects.size(); i++) {
+		glm::vec3 p = marqueeObjects[i]->getMatrix()[3];
+		marqueePoints.set(i, p, p);
+	}
 
+	marqueeInside.clear();
+	boxesInFrustum(marqueePoints, frustum.planes, marqueeInside);
+	for (int i : marqueeInside) select(marqueeObjects[i]);
+	profiler().setCounter("marquee", (int64_t)marqueeInside.size());
 }
 
 //--------------------------------------------------------------
@@ -11,25 +11,28 @@
 //
 
 #include "ofMain.h"
-#include "box.h"
 #include "Primitives.h"
+#include "SkeletonPose.h"
+#include "PoseKernels.h"
+#include "PoseCache.h"
+#include "AnimationWorker.h"
+#include "SceneArena.h"
+#include "SceneIO.h"
+#include "SceneGenerator.h"
+#include "Profiler.h"
+#include "SceneBVH.h"
+#include "SceneCuller.h"
+#include "SelectionSet.h"
+#include "SceneRenderer.h"
 #include "ofxGui.h"
 
-class KeyFrame {
-public:
-	int frame = -1;     //  -1 => no key is set;
-	glm::vec3 position = glm::vec3(0, 0, 0);   // translate channel
-	glm::vec3 rotation = glm::vec3(0, 0, 0);   // rotate channel
-	glm::vec3 scale = glm::vec3(1, 1, 1);   // rotate channel
-	SceneObject* obj = NULL;                   // object that is keyframed
-};
-
 class ofApp : public ofBaseApp {
 
 public:
 	void setup();
 	void update();
 	void draw();
+	void exit();
 
 	void keyPressed(int key);
 	void keyReleased(int key);
@@ -44,19 +47,64 @@ public:
 	void gotMessage(ofMessage msg);
 	static void drawAxis(glm::mat4 transform = glm::mat4(1.0), float len = 1.0);
 	bool mouseToDragPlane(int x, int y, glm::vec3& point);
+	SceneObject* pickObject(int x, int y);
+	void drawHover();
 	void printChannels(SceneObject*);
-	bool objSelected() { return (selected.size() ? true : false); };
+	bool objSelected() { return (selectedObject() != NULL); };
+
+	// first selected object, NULL if nothing (that still exists) is selected
+	//
+	SceneObject* selectedObject() { return scene.get(selected.primary()); }
+
+	// every selected object that still exists
+	//
+	vector<SceneObject*> selectedObjects() {
+		vector<SceneObject*> objects;
+		for (auto& handle : selected.handles()) {
+			SceneObject* obj = scene.get(handle);
+			if (obj) objects.push_back(obj);
+		}
+		return objects;
+	}
+
+	// the primary selection / every selected object that is a joint.  the
+	// arena knows the type from the handle, no dynamic_cast needed
+	//
+	Joint* selectedJoint() { return scene.asJoint(selectedObject()); }
+	vector<Joint*> selectedJoints() {
+		vector<Joint*> joints;
+		joints.reserve(selected.size());
+		for (auto& handle : selected.handles()) {
+			Joint* joint = scene.asJoint(scene.get(handle));
+			if (joint) joints.push_back(joint);
+		}
+		return joints;
+	}
 	void addJoint();
 	void deleteObject();
 	//void saveToFile(string& filename);
 	void saveToFile();
 	void loadFile();
+	void loadAnimFile(const string& filePath);
+	void loadFinished();
+	void clearScene();
+	void loadSceneJoints(const vector<SceneJoint>& joints);
+	void generateTestScene();
+	void loadSkin();
+	Mesh* addMesh(const SkinnedMesh& skin);
+	void drawProfiler();
+	void saveTrace();
+	void collectJoints(vector<SceneJoint>& joints);
 	void clearSelectionList() {
-		for (int i = 0; i < selected.size(); i++) {
-			selected[i]->isSelected = false;
+		for (auto obj : selectedObjects()) {
+			obj->isSelected = false;
 		}
 		selected.clear();
 	}
+	void select(SceneObject* obj) {
+		if (selected.insert(obj->handle)) obj->isSelected = true;
+	}
+	void selectInRect(const glm::vec2& corner0, const glm::vec2& corner1);
 
 	// key framing
 //
@@ -100,18 +148,13 @@ public:
 	// linear interpolation between two keyframes
 	//
 	glm::vec3 linearInterp(int frame, int frameStart, int frameEnd, const glm::vec3& start, const glm::vec3& end) {
-		return mapVec(frame, frameStart, frameEnd, start, end);
+		return keyInterp(frame, frameStart, frameEnd, start, end, false);
 	}
 
 	// example non-linear interpolation between two keyframes (ease-in ease-out)
 	//
 	glm::vec3 easeInterp(int frame, int frameStart, int frameEnd, const glm::vec3& start, const glm::vec3& end) {
-
-		// normalize range (0 to 1) and input to ease formula
-		//
-		float s = ease(ofMap(frame, frameStart, frameEnd, 0.0, 1.0));
-
-		return mapVec(s, 0.0, 1.0, start, end);
+		return keyInterp(frame, frameStart, frameEnd, start, end, true);
 	}
 
 
@@ -119,7 +162,7 @@ public:
 	//  this function produces a sigmoid curve normalized in x, y in (0 to 1);
 	//
 	float ease(float x) {
-		return (x * x / (x * x + (1 - x) * (1 - x)));
+		return keyEase(x);
 	}
 
 	// helper functions to use ofMap on a vector
@@ -148,81 +191,81 @@ public:
 	// this "cycles" until you call resetKeyFrames();
 	//
 	void setKeyFrame() {
-		if (selected.empty()) {
+		if (!objSelected()) {
 			cout << "No object selected. Cannot set keyframe." << endl;
 			return;
 		}
+		vector<Joint*> joints = selectedJoints();
+		if (joints.empty()) {
+			cout << "No joint selected. Cannot set keyframe." << endl;
+			return;
+		}
 
-		for (auto obj : selected) {
-			Joint* joint = dynamic_cast<Joint*>(obj);
-			if (joint) {
-				KeyFrame keyFrame;
-				keyFrame.frame = frame;
-				keyFrame.position = joint->position;
-				keyFrame.rotation = joint->rotation;
-				keyFrame.scale = joint->scale;
-
-				joint->keyFrames.push_back(keyFrame);
-				cout << "Setting keyframe at frame: " << frame << endl;
-			}
-			else {
-				cout << "Cannot set keyframe." << endl;
+		// all joints are keyed in one pass and handed to the worker as one command
+		//
+		vector<int> slots;
+		vector<KeyFrame> keys;
+		slots.reserve(joints.size());
+		keys.reserve(joints.size());
+		for (Joint* joint : joints) {
+			KeyFrame keyFrame;
+			keyFrame.frame = frame;
+			keyFrame.position = joint->position;
+			keyFrame.rotation = joint->getEulerRotation();
+			keyFrame.orientation = joint->getRotationQuat();
+			keyFrame.scale = joint->scale;
+			joint->setKey(keyFrame);
+			if (!bPoseStale) {
+				slots.push_back(pose.indexOf(joint));
+				keys.push_back(keyFrame);
 			}
 		}
+		if (!bPoseStale) animWorker.setKey(slots, keys);
+		cout << "Setting keyframe at frame: " << frame << " (" << joints.size() << " joints)" << endl;
 	}
 
-	void interpolateKeyFrames() {
-		for (auto& obj : scene) {
-			Joint* joint = dynamic_cast<Joint*>(obj);
-			if (joint && joint->keyFrames.size() > 1) {
-				for (size_t i = 0; i < joint->keyFrames.size() - 1; i++) {
-					KeyFrame& kf1 = joint->keyFrames[i];
-					KeyFrame& kf2 = joint->keyFrames[i + 1];
-
-					if (frame >= kf1.frame && frame <= kf2.frame) {
-						if (useEaseInterpolation) {
-							// Use ease interpolation
-							joint->position = easeInterp(frame, kf1.frame, kf2.frame, kf1.position, kf2.position);
-							joint->rotation = easeInterp(frame, kf1.frame, kf2.frame, kf1.rotation, kf2.rotation);
-							joint->scale = easeInterp(frame, kf1.frame, kf2.frame, kf1.scale, kf2.scale);
-						}
-						else {
-							// Use linear interpolation
-							joint->position = linearInterp(frame, kf1.frame, kf2.frame, kf1.position, kf2.position);
-							joint->rotation = linearInterp(frame, kf1.frame, kf2.frame, kf1.rotation, kf2.rotation);
-							joint->scale = linearInterp(frame, kf1.frame, kf2.frame, kf1.scale, kf2.scale);
-						}
-						break;
-					}
-				}
-			}
-		}
+	// hand the current frame to the animation worker; the pose shows up in
+	// draw() once the worker has evaluated it.
+	//
+	void showFrame() {
+		animWorker.setFrame(frame);
+	}
+
+	// a key of joint at frame was set or deleted.  A stale pose is rebuilt with
+	// all keys in update(), so there is nothing to send in that case.
+	//
+	void keysChanged(Joint* joint, int frame) {
+		if (!bPoseStale) animWorker.setKeys(pose.indexOf(joint), joint->keyFrames, frame);
+	}
+
+	// position/rotation/scale of obj were edited
+	//
+	void channelsChanged(SceneObject* obj) {
+		if (!bPoseStale) animWorker.setChannels(pose.indexOf(obj), obj);
+	}
+
+	void interpolationChanged(bool& b) {
+		animWorker.setInterpolation(useEaseInterpolation, useSlerp);
 	}
 
+	void applyLatestPose();
+
 	void deleteKeyFrame() {
 		if (!objSelected()) {
 			cout << "No object selected. Cannot delete keyframe." << endl;
 			return;
 		}
 
-		for (auto obj : selected) {
-			Joint* joint = dynamic_cast<Joint*>(obj);
-			if (joint) {
-				auto it = std::remove_if(joint->keyFrames.begin(), joint->keyFrames.end(),
-					[&](const KeyFrame& k) { return k.frame == frame; });
-
-				if (it != joint->keyFrames.end()) {
-					joint->keyFrames.erase(it, joint->keyFrames.end());
-					cout << "Deleted keyframe for frame: " << frame << endl;
-				}
-				else {
-					cout << "No keyframe found at frame: " << frame << endl;
-				}
-			}
-			else {
-				cout << "Selected object is not a joint. Cannot delete keyframe." << endl;
-			}
+		vector<int> slots;
+		int deleted = 0;
+		for (Joint* joint : selectedJoints()) {
+			if (!joint->deleteKey(frame)) continue;
+			deleted++;
+			if (!bPoseStale) slots.push_back(pose.indexOf(joint));
 		}
+		if (!bPoseStale) animWorker.deleteKey(slots, frame);
+		if (deleted) cout << "Deleted keyframe for frame: " << frame << " (" << deleted << " joints)" << endl;
+		else cout << "No keyframe found at frame: " << frame << endl;
 	}
 
 	// reset key frames
@@ -234,28 +277,32 @@ public:
 		}
 		bKey2Next = false;*/
 
-		if (objSelected()) {
-			Joint* selectedJoint = dynamic_cast<Joint*>(selected[0]);
-			if (selectedJoint) {
-				selectedJoint->keyFrames.clear();
-				bKey2Next = false;
-			}
+		Joint* joint = selectedJoint();
+		if (joint) {
+			joint->keyFrames.clear();
+			bKey2Next = false;
+			keysChanged(joint, frame);
 		}
 	}
 
 	void resetRotation() {
-		if (objSelected()) {
-			for (auto& obj : selected) {
-				Joint* joint = dynamic_cast<Joint*>(obj);
-				if (joint) {
-					joint->rotation = glm::vec3(0, 0, 0);
-					cout << "Rotations reset to zero, " << joint->name << endl;
-				}
-			}
-		}
-		else {
+		vector<Joint*> joints = selectedJoints();
+		if (joints.empty()) {
 			cout << "No joint selected to reset rotation." << endl;
+			return;
+		}
+
+		vector<int> slots;
+		vector<SceneObject*> objects;
+		for (Joint* joint : joints) {
+			joint->setRotation(glm::vec3(0, 0, 0));
+			if (!bPoseStale) {
+				slots.push_back(pose.indexOf(joint));
+				objects.push_back(joint);
+			}
 		}
+		if (!bPoseStale) animWorker.setChannels(slots, objects);
+		cout << "Rotations reset to zero (" << joints.size() << " joints)" << endl;
 	}
 
 	// Lights
@@ -277,14 +324,55 @@ public:
 	// scene components
 	//
 	ofxToggle useEaseInterpolation;
-	vector<SceneObject*> scene;
-	vector<SceneObject*> selected;
+	ofxToggle useSlerp;        // quaternion joints: slerp instead of nlerp
+	SceneArena scene;          // owns every object in the scene
+	SelectionSet selected;
+	SceneRenderer renderer;    // instanced joints, bones and axes
+	SkeletonPose pose;         // slot order shared with the animation worker
+	bool bPoseStale = true;    // true => hierarchy changed, pose must be rebuilt
+	AnimationWorker animWorker;
+
+	// view frustum culling, rebuilt together with the pose
+	//
+	SceneCuller culler;
+
+	// picking
+	//
+	SceneBVH pickBVH;
+	bool bPickStale = true;    // true => objects added/deleted, tree must be rebuilt
+	uint64_t pickFrame = 0;    // frame the tree was last refit in (+1, 0 => never)
+	SceneHandle hovered;       // object under the mouse, picked on every move
+
+	// marquee selection: drag a rectangle from an empty spot (ctrl adds)
+	//
+	bool bMarquee = false;
+	glm::vec2 marqueeStart, marqueeEnd;
+	vector<SceneObject*> marqueeObjects;    // selectable objects, in the order of marqueePoints
+	BoxPackets marqueePoints;               // their world positions (zero size boxes)
+	vector<int> marqueeInside;
+
+	// stress test scene, 'g' key (SceneGen on the command line)
+	//
+	SceneGenParams genParams;
+	bool bGenerateSkin = true;     // also skin the generated rigs
+
+	// skinned meshes (scene.all<Mesh>()) are deformed every frame.  'm' loads
+	// one, 'w' switches them between linear blend and dual quaternion skinning
+	//
+	SkinMode skinMode = SKIN_LINEAR;    // mode of new meshes
+
+	// profiling: 'o' shows the overlay, 't' writes a Chrome trace
+	//
+	bool bShowProfiler = false;
+	double traceSeconds = 10.0;
+
 	ofPlanePrimitive plane;
 	int jointCounter = 0;
 	ofxPanel gui;
 	ofxLabel rotationText;
 
 	vector<KeyFrame> keyFrames;
+
 	int frame = 1;         // current frame
 	int frameBegin = 1;     // first frame of playback range;
 	int frameEnd = 501;     // last frame of playback range;
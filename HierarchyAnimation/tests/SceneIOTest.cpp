@@ -0,0 +1,154 @@
+//
+//  SceneIOTest.cpp - round trip of generated scenes through both scene formats
+//
+//  Every generator shape (Euler and quaternion rotation) is written with
+//  writeTextScene() and writeAnimFile() and read back; joints and keys must come
+//  back unchanged: exactly from the binary format, to the printed precision from
+//  the text format.  Also checks that a self or forward parent loads as a root
+//  and that keys out of order are rejected.
+//
+//  Run by ctest; returns non-zero if any check fails.
+//
+
+#include "SceneGenerator.h"
+#include "SceneIO.h"
+#include <algorithm>
+#include <cstdio>
+#include <cstring>
+#include <cmath>
+#include <fstream>
+#include <string>
+
+static int failures = 0;
+
+static void check(bool bOk, const std::string &what) {
+	if (bOk) return;
+	fprintf(stderr, "FAILED: %s\n", what.c_str());
+	failures++;
+}
+
+// text files print floats with 6 significant digits
+//
+static bool near(float a, float b, bool bExact) {
+	if (bExact) return (a == b);
+	return (std::fabs(a - b) <= 1e-5f * std::max(1.0f, std::fabs(a)));
+}
+
+static bool near(const glm::vec3 &a, const glm::vec3 &b, bool bExact) {
+	return (near(a.x, b.x, bExact) && near(a.y, b.y, bExact) && near(a.z, b.z, bExact));
+}
+
+static bool near(const glm::quat &a, const glm::quat &b, bool bExact) {
+	return (near(a.x, b.x, bExact) && near(a.y, b.y, bExact) && near(a.z, b.z, bExact) && near(a.w, b.w, bExact));
+}
+
+// orientations are only stored for quaternion joints
+//
+static void compare(const std::vector<SceneJoint> &expected, const std::vector<SceneJoint> &loaded,
+	bool bExact, const std::string &name) {
+
+	check(loaded.size() == expected.size(), name + ": joint count");
+	for (size_t i = 0; i < expected.size() && i < loaded.size(); i++) {
+		const SceneJoint &a = expected[i];
+		const SceneJoint &b = loaded[i];
+		std::string where = name + ": joint " + a.name;
+		check(a.name == b.name && a.parent == b.parent && a.bQuatRotation == b.bQuatRotation, where + " hierarchy");
+		check(near(a.position, b.position, bExact) && near(a.rotation, b.rotation, bExact) &&
+			near(a.scale, b.scale, bExact), where + " channels");
+		if (a.bQuatRotation) check(near(a.orientation, b.orientation, bExact), where + " orientation");
+
+		check(a.keyFrames.size() == b.keyFrames.size(), where + " key count");
+		for (size_t k = 0; k < a.keyFrames.size() && k < b.keyFrames.size(); k++) {
+			const KeyFrame &ka = a.keyFrames[k];
+			const KeyFrame &kb = b.keyFrames[k];
+			bool bSame = ka.frame == kb.frame && near(ka.position, kb.position, bExact) &&
+				near(ka.rotation, kb.rotation, bExact) && near(ka.scale, kb.scale, bExact) &&
+				(!a.bQuatRotation || near(ka.orientation, kb.orientation, bExact));
+			check(bSame, where + " key " + std::to_string(k));
+			if (!bSame) break;
+		}
+	}
+}
+
+static void roundTrip(const SceneGenParams &params, const std::string &name) {
+	std::vector<SceneJoint> joints, loaded;
+	generateScene(params, joints);
+
+	const std::string textPath = "SceneIOTest.txt";
+	check(writeTextScene(textPath, joints), name + ": write text");
+	check(readTextScene(textPath, loaded), name + ": read text");
+	compare(joints, loaded, false, name + " (text)");
+	remove(textPath.c_str());
+
+	const std::string animPath = "SceneIOTest.hanim";
+	check(writeAnimFile(animPath, joints), name + ": write binary");
+	check(readAnimFile(animPath, loaded), name + ": read binary");
+	compare(joints, loaded, true, name + " (binary)");
+	remove(animPath.c_str());
+
+	size_t keys = 0;
+	for (const auto &joint : joints) keys += joint.keyFrames.size();
+	printf("%-24s %6zu joints %8zu keys\n", name.c_str(), joints.size(), keys);
+}
+
+// swap the first two keys of the first joint that has two
+//
+static void swapKeys(const std::string &path) {
+	std::fstream file(path, std::ios::in | std::ios::out | std::ios::binary);
+	AnimFileHeader header;
+	file.read((char *)&header, sizeof(header));
+	for (uint32_t i = 0; i < header.jointCount; i++) {
+		AnimJointEntry e;
+		file.seekg(header.jointsOffset + i * sizeof(e));
+		file.read((char *)&e, sizeof(e));
+		if (e.keyCount < 2) continue;
+		AnimKeyRecord keys[2];
+		file.seekg(header.keysOffset + e.firstKey * sizeof(AnimKeyRecord));
+		file.read((char *)keys, sizeof(keys));
+		std::swap(keys[0], keys[1]);
+		file.seekp(header.keysOffset + e.firstKey * sizeof(AnimKeyRecord));
+		file.write((const char *)keys, sizeof(keys));
+		return;
+	}
+}
+
+static void invalidFiles() {
+	std::vector<SceneJoint> joints;
+	const char *selfParent = "Joint: a\nParent: a\n";
+	check(parseTextScene(selfParent, selfParent + strlen(selfParent), joints) &&
+		joints.size() == 1 && joints[0].parent == -1, "self parent loads as a root");
+	joints.clear();
+	const char *forwardParent = "Joint: a\nParent: b\n\nJoint: b\nParent: a\n";
+	check(parseTextScene(forwardParent, forwardParent + strlen(forwardParent), joints) &&
+		joints.size() == 2 && joints[0].parent == -1 && joints[1].parent == 0, "forward parent loads as a root");
+
+	SceneGenParams params;
+	params.jointsPerRig = 10;
+	generateScene(params, joints);
+	const std::string animPath = "SceneIOTest.hanim";
+	writeAnimFile(animPath, joints);
+	swapKeys(animPath);
+	AnimFile anim;
+	check(!anim.open(animPath), "keys out of order are rejected");
+	anim.close();
+	remove(animPath.c_str());
+}
+
+int main() {
+	const SceneGenShape shapes[] = { GEN_CHAIN, GEN_FAN, GEN_TREE, GEN_HUMANOID };
+	const char *shapeNames[] = { "chain", "fan", "tree", "humanoid" };
+	for (int s = 0; s < 4; s++) {
+		for (int q = 0; q < 2; q++) {
+			SceneGenParams params;
+			params.shape = shapes[s];
+			params.bQuatRotation = (q == 1);
+			params.curve = (q == 1 ? GEN_RANDOM : GEN_SINE);
+			params.copies = (shapes[s] == GEN_HUMANOID ? 20 : 2);
+			roundTrip(params, std::string(shapeNames[s]) + (q == 1 ? "/quat" : ""));
+		}
+	}
+	invalidFiles();
+
+	if (failures) fprintf(stderr, "%d checks failed\n", failures);
+	return (failures ? 1 : 0);
+}
@@ -0,0 +1,99 @@
+//
+//  SceneGen.cpp - command line front end of the synthetic scene generator
+//
+//  Writes a generated skeleton with keys to a file the app can load: .hanim files
+//  in the binary format, anything else as text (see SceneIO.h).
+//
+//  usage: SceneGen [options] output
+//
+//    --shape chain|fan|tree|humanoid    (tree)
+//    --joints N        joints per rig   (1000, not used for humanoid)
+//    --branching N     tree fan-out     (3)
+//    --copies N        number of rigs   (1)
+//    --frames A B      keyed range      (1 500)
+//    --interval N      frames per key   (25)
+//    --curve sine|random|step           (sine)
+//    --amplitude D     degrees          (30)
+//    --period N        frames, sine     (100)
+//    --quat            quaternion rotation channel
+//    --seed N                           (1)
+//    --skin file       also write a skin for the skeleton (see SkinnedMesh.h)
+//
+
+#include "SceneGenerator.h"
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+
+static void usage(const char *name) {
+	fprintf(stderr, "usage: %s [--shape chain|fan|tree|humanoid] [--joints N] [--branching N] [--copies N]\n"
+		"       [--frames A B] [--interval N] [--curve sine|random|step] [--amplitude D] [--period N]\n"
+		"       [--quat] [--seed N] [--skin file] output\n", name);
+}
+
+int main(int argc, char **argv) {
+	SceneGenParams params;
+	std::string output;
+	std::string skinOutput;
+	for (int i = 1; i < argc; i++) {
+		bool bHasValue = (i + 1 < argc);
+		const char *arg = argv[i];
+		if (!strcmp(arg, "--quat")) params.bQuatRotation = true;
+		else if (!strcmp(arg, "--shape") && bHasValue) {
+			if (!parseSceneGenShape(argv[++i], params.shape)) {
+				fprintf(stderr, "unknown shape %s\n", argv[i]);
+				return 1;
+			}
+		}
+		else if (!strcmp(arg, "--curve") && bHasValue) {
+			if (!parseSceneGenCurve(argv[++i], params.curve)) {
+				fprintf(stderr, "unknown curve %s\n", argv[i]);
+				return 1;
+			}
+		}
+		else if (!strcmp(arg, "--joints") && bHasValue) params.jointsPerRig = atoi(argv[++i]);
+		else if (!strcmp(arg, "--branching") && bHasValue) params.branching = atoi(argv[++i]);
+		else if (!strcmp(arg, "--copies") && bHasValue) params.copies = atoi(argv[++i]);
+		else if (!strcmp(arg, "--frames") && i + 2 < argc) {
+			params.frameBegin = atoi(argv[++i]);
+			params.frameEnd = atoi(argv[++i]);
+		}
+		else if (!strcmp(arg, "--interval") && bHasValue) params.keyInterval = atoi(argv[++i]);
+		else if (!strcmp(arg, "--amplitude") && bHasValue) params.amplitude = (float)atof(argv[++i]);
+		else if (!strcmp(arg, "--period") && bHasValue) params.period = (float)atof(argv[++i]);
+		else if (!strcmp(arg, "--seed") && bHasValue) params.seed = (unsigned int)strtoul(argv[++i], NULL, 10);
+		else if (!strcmp(arg, "--skin") && bHasValue) skinOutput = argv[++i];
+		else if (arg[0] != '-' && output.empty()) output = arg;
+		else {
+			usage(argv[0]);
+			return 1;
+		}
+	}
+	if (output.empty() || params.frameEnd < params.frameBegin) {
+		usage(argv[0]);
+		return 1;
+	}
+
+	std::vector<SceneJoint> joints;
+	generateScene(params, joints);
+	size_t keys = 0;
+	for (const auto &joint : joints) keys += joint.keyFrames.size();
+
+	bool bSaved = (isAnimFilePath(output) ? writeAnimFile(output, joints) : writeTextScene(output, joints));
+	if (!bSaved) {
+		fprintf(stderr, "can't write %s\n", output.c_str());
+		return 1;
+	}
+	printf("%s: %zu joints, %zu keys\n", output.c_str(), joints.size(), keys);
+
+	if (!skinOutput.empty()) {
+		SkinnedMesh skin;
+		generateSkin(joints, skin);
+		if (!writeSkinFile(skinOutput, skin)) {
+			fprintf(stderr, "can't write %s\n", skinOutput.c_str());
+			return 1;
+		}
+		printf("%s: %d vertices, %zu triangles\n", skinOutput.c_str(), skin.vertexCount(), skin.indices.size() / 3);
+	}
+	return 0;
+}